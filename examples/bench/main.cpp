@@ -0,0 +1,188 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "nforce/bdd.h"
+#include "nforce/expr.h"
+#include "nforce/jit.h"
+#include "nforce/truth_table.h"
+
+using namespace n4;
+
+//
+// Evaluation backends micro benchmark: the same random expression is
+// evaluated over the same random records by each backend, reporting the
+// time per record. Leaves only read a bit of the record so that the
+// figures show the cost of the expression skeleton.
+//
+
+namespace {
+struct options {
+  std::size_t leaves{12};
+  std::size_t depth{6};
+  std::size_t records{1 << 20};
+  std::size_t rounds{5};
+  unsigned seed{1};
+};
+
+// random expression over the bits of the current record
+class generator {
+  const std::uint8_t *const &_rec;
+  std::size_t _leaves;
+  std::mt19937 _gen;
+
+  std::unique_ptr<expr> leaf() {
+    std::uniform_int_distribution<std::size_t> pick{0, _leaves - 1};
+    auto i = pick(_gen);
+    return std::make_unique<rule_expr>([&rec = _rec, i] { return rec[i]; },
+                                       "b" + std::to_string(i));
+  }
+
+  template <binary_op_type Op> std::unique_ptr<expr> binary(std::size_t d) {
+    auto e = std::make_unique<binary_gen_expr<Op>>();
+    e->set_left_op(make(d - 1));
+    e->set_right_op(make(d - 1));
+    return e;
+  }
+
+public:
+  generator(const std::uint8_t *const &rec, std::size_t leaves, unsigned seed)
+      : _rec{rec}, _leaves{leaves}, _gen{seed} {}
+
+  std::unique_ptr<expr> make(std::size_t depth) {
+    std::uniform_int_distribution<int> kind{0, depth ? 4 : 0};
+    switch (kind(_gen)) {
+    case 1:
+    case 2:
+      return binary<binary_op_type::AND>(depth);
+    case 3:
+      return binary<binary_op_type::OR>(depth);
+    case 4: {
+      auto e = std::make_unique<unary_not_expr>();
+      e->set_op(make(depth - 1));
+      return e;
+    }
+    default:
+      return leaf();
+    }
+  }
+};
+
+struct backend {
+  std::string name;
+  std::function<std::unique_ptr<expr>(std::unique_ptr<expr>)> compile;
+};
+
+void run(const options &opts) {
+  std::vector<std::uint8_t> records(opts.leaves * opts.records);
+  std::mt19937 gen{opts.seed};
+  std::bernoulli_distribution bit{0.5};
+  for (auto &b : records) {
+    b = bit(gen);
+  }
+
+  const std::vector<backend> backends{
+      {"tree", [](auto e) { return e; }},
+      {"flatten", [](auto e) { return flatten(std::move(e)); }},
+      {"truth_table",
+       [](auto e) { return compile_truth_table(std::move(e)); }},
+      {"bdd", [](auto e) { return compile_bdd(std::move(e)); }},
+      {"jit", [](auto e) { return compile_jit(std::move(e)); }}};
+
+  std::cout << "[+][nbench] " << opts.records << " records, "
+            << opts.leaves << " leaves, depth " << opts.depth
+            << (jit_expr::available() ? "" : ", jit unavailable")
+            << std::endl;
+
+  for (const auto &b : backends) {
+    // each backend gets its own copy of the same expression
+    const std::uint8_t *rec = records.data();
+    generator g{rec, opts.leaves, opts.seed};
+    auto e = b.compile(g.make(opts.depth));
+
+    auto best = std::chrono::duration<double>::max();
+    std::size_t matches = 0;
+    for (std::size_t r = 0; r < opts.rounds; ++r) {
+      matches = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (std::size_t i = 0; i < opts.records; ++i) {
+        rec = records.data() + i * opts.leaves;
+        matches += e->interpret();
+      }
+      best = std::min<std::chrono::duration<double>>(
+          best, std::chrono::steady_clock::now() - start);
+    }
+
+    std::cout << " - " << b.name << ": " << best.count() * 1e9 / opts.records
+              << " ns/record (" << matches << " matches)" << std::endl;
+  }
+}
+
+void usage() {
+  std::cerr << "[-][nbench] usage: nbench [-l leaves] [-d depth] "
+               "[-n records] [-r rounds] [-s seed]"
+            << std::endl;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  options opts;
+  try {
+    int c;
+    while ((c = ::getopt(argc, argv, "l:d:n:r:s:h")) != -1) {
+      switch (c) {
+      case 'l':
+        opts.leaves = std::max(1ul, std::stoul(optarg));
+        break;
+      case 'd':
+        opts.depth = std::stoul(optarg);
+        break;
+      case 'n':
+        opts.records = std::max(1ul, std::stoul(optarg));
+        break;
+      case 'r':
+        opts.rounds = std::max(1ul, std::stoul(optarg));
+        break;
+      case 's':
+        opts.seed = static_cast<unsigned>(std::stoul(optarg));
+        break;
+      default:
+        usage();
+        return 1;
+      }
+    }
+  } catch (const std::exception &) {
+    usage();
+    return 1;
+  }
+
+  try {
+    run(opts);
+  } catch (const std::exception &e) {
+    std::cerr << "[-][nbench] failed with error : " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,528 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nforce/expr.h"
+#include "nforce/lexer.h"
+#include "nforce/memo.h"
+#include "nforce/parser.h"
+#include "nforce/pushdown.h"
+
+using namespace n4;
+
+//
+// Linux counterpart of the iat example used to apply filter to the dynamic
+// imports of a batch of elf binaries
+//
+// Binaries are mmap'd and entries only hold views into the mappings, library
+// names being interned into small ids so that filtering and sorting never
+// copy any string.
+//
+
+namespace {
+// read-only mapping of a binary, alive as long as the entries using it
+class mapped_file {
+  void *_addr{MAP_FAILED};
+  std::size_t _size{0};
+
+public:
+  explicit mapped_file(std::string const &path) {
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("bad binary path " + path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      _size = static_cast<std::size_t>(st.st_size);
+      _addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+
+    if (_addr == MAP_FAILED) {
+      throw std::runtime_error("cannot map " + path);
+    }
+  }
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  ~mapped_file() { ::munmap(_addr, _size); }
+
+  const unsigned char *data() const {
+    return static_cast<const unsigned char *>(_addr);
+  }
+
+  std::size_t size() const { return _size; }
+};
+
+// interned strings, views must outlive the pool
+class string_pool {
+  std::unordered_map<std::string_view, std::uint32_t> _ids;
+  std::vector<std::string_view> _names;
+
+public:
+  std::uint32_t intern(std::string_view str) {
+    auto hit = _ids.emplace(str, static_cast<std::uint32_t>(_names.size()));
+    if (hit.second) {
+      _names.push_back(str);
+    }
+    return hit.first->second;
+  }
+
+  std::string_view name(std::uint32_t id) const { return _names[id]; }
+
+  std::size_t size() const { return _names.size(); }
+
+  // rank of each id in lexicographic order of names
+  std::vector<std::uint32_t> ranks() const {
+    std::vector<std::uint32_t> order(_names.size());
+    for (std::uint32_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::sort(std::begin(order), std::end(order),
+              [this](auto i1, auto i2) { return _names[i1] < _names[i2]; });
+
+    std::vector<std::uint32_t> rank(order.size());
+    for (std::uint32_t i = 0; i < order.size(); ++i) {
+      rank[order[i]] = i;
+    }
+    return rank;
+  }
+};
+
+// data model to store import analysis results
+struct entry {
+  std::string_view name;
+  std::string_view version;
+  std::uint32_t module;
+  std::uint32_t file;
+};
+
+using entry_list = std::vector<entry>;
+
+struct import_table {
+  std::vector<std::unique_ptr<mapped_file>> files;
+  std::vector<std::string> paths;
+  string_pool modules;
+  entry_list entries;
+};
+
+// generic rule over the current entry, regex compiled once per rule
+class regex_rule {
+  std::string_view const &_ctxt;
+  std::regex _regx;
+  std::unordered_map<std::string, std::regex> _cache;
+
+public:
+  regex_rule(std::string const &reg, std::string_view const &ctxt)
+      : _ctxt{ctxt}, _regx{reg} {}
+
+  bool do_handle(std::string const &str) {
+    std::smatch matches;
+    if (!std::regex_match(str, matches, _regx) || matches.size() != 2) {
+      return false;
+    }
+
+    try {
+      _cache.emplace(str, std::regex{matches[1].str(), std::regex::optimize});
+    } catch (std::regex_error const &) {
+      return false;
+    }
+    return true;
+  }
+
+  bool interpret(std::string const &str) const {
+    auto hit = _cache.find(str);
+    if (hit == std::cend(_cache)) {
+      throw std::runtime_error("bad rule " + str);
+    }
+
+    return std::regex_match(_ctxt.begin(), _ctxt.end(), hit->second);
+  }
+};
+
+// build imports
+struct elf64 {
+  using ehdr = Elf64_Ehdr;
+  using shdr = Elf64_Shdr;
+  using sym = Elf64_Sym;
+  using versym = Elf64_Half;
+  using verneed = Elf64_Verneed;
+  using vernaux = Elf64_Vernaux;
+  static constexpr unsigned char elf_class = ELFCLASS64;
+};
+
+struct elf32 {
+  using ehdr = Elf32_Ehdr;
+  using shdr = Elf32_Shdr;
+  using sym = Elf32_Sym;
+  using versym = Elf32_Half;
+  using verneed = Elf32_Verneed;
+  using vernaux = Elf32_Vernaux;
+  static constexpr unsigned char elf_class = ELFCLASS32;
+};
+
+template <typename T>
+const T *at(mapped_file const &f, std::size_t off, std::size_t count = 1) {
+  if (off > f.size() || count > (f.size() - off) / sizeof(T)) {
+    throw std::runtime_error("truncated binary");
+  }
+  return reinterpret_cast<const T *>(f.data() + off);
+}
+
+std::string_view str_at(mapped_file const &f, std::size_t tab,
+                        std::size_t tab_size, std::size_t off) {
+  if (off >= tab_size || tab + tab_size > f.size()) {
+    return {};
+  }
+  auto begin = reinterpret_cast<const char *>(f.data() + tab + off);
+  auto end = static_cast<const char *>(std::memchr(begin, 0, tab_size - off));
+  return end ? std::string_view(begin, end - begin) : std::string_view{};
+}
+
+// import read from a binary, only added to the table once the whole binary
+// has parsed so that no view outlives the mapping of a failed binary
+struct parsed_import {
+  std::string_view name;
+  std::string_view version;
+  std::string_view module;
+};
+
+template <typename Elf> std::vector<parsed_import> parse(mapped_file const &f) {
+  std::vector<parsed_import> imports;
+  auto eh = at<typename Elf::ehdr>(f, 0);
+  auto sh = at<typename Elf::shdr>(f, eh->e_shoff, eh->e_shnum);
+
+  const typename Elf::shdr *dynsym = nullptr;
+  const typename Elf::shdr *versym = nullptr;
+  const typename Elf::shdr *verneed = nullptr;
+  for (std::size_t i = 0; i < eh->e_shnum; ++i) {
+    switch (sh[i].sh_type) {
+    case SHT_DYNSYM:
+      dynsym = &sh[i];
+      break;
+    case SHT_GNU_versym:
+      versym = &sh[i];
+      break;
+    case SHT_GNU_verneed:
+      verneed = &sh[i];
+      break;
+    }
+  }
+
+  if (!dynsym || dynsym->sh_link >= eh->e_shnum) {
+    return imports; // static binary
+  }
+
+  auto const &dynstr = sh[dynsym->sh_link];
+
+  // version index -> (library, version)
+  std::unordered_map<std::uint16_t,
+                     std::pair<std::string_view, std::string_view>>
+      needs;
+  if (verneed && verneed->sh_link < eh->e_shnum) {
+    auto const &vstr = sh[verneed->sh_link];
+    std::size_t off = verneed->sh_offset;
+    for (std::size_t i = 0; i < verneed->sh_info; ++i) {
+      auto vn = at<typename Elf::verneed>(f, off);
+      auto lib = str_at(f, vstr.sh_offset, vstr.sh_size, vn->vn_file);
+
+      std::size_t aoff = off + vn->vn_aux;
+      for (std::size_t j = 0; j < vn->vn_cnt; ++j) {
+        auto vna = at<typename Elf::vernaux>(f, aoff);
+        needs.emplace(vna->vna_other,
+                      std::make_pair(lib, str_at(f, vstr.sh_offset,
+                                                 vstr.sh_size, vna->vna_name)));
+        if (!vna->vna_next) {
+          break;
+        }
+        aoff += vna->vna_next;
+      }
+
+      if (!vn->vn_next) {
+        break;
+      }
+      off += vn->vn_next;
+    }
+  }
+
+  auto count = dynsym->sh_entsize ? dynsym->sh_size / dynsym->sh_entsize : 0;
+  auto syms = at<typename Elf::sym>(f, dynsym->sh_offset, count);
+  auto vers =
+      (versym && versym->sh_size / sizeof(typename Elf::versym) >= count)
+          ? at<typename Elf::versym>(f, versym->sh_offset, count)
+          : nullptr;
+
+  for (std::size_t i = 1; i < count; ++i) {
+    if (syms[i].st_shndx != SHN_UNDEF) {
+      continue;
+    }
+
+    auto name = str_at(f, dynstr.sh_offset, dynstr.sh_size, syms[i].st_name);
+    if (name.empty()) {
+      continue;
+    }
+
+    parsed_import imp{name, {}, "?"};
+    if (vers) {
+      auto hit = needs.find(vers[i] & 0x7fff);
+      if (hit != std::cend(needs)) {
+        imp.module = hit->second.first;
+        imp.version = hit->second.second;
+      }
+    }
+    imports.push_back(imp);
+  }
+  return imports;
+}
+
+void build(std::string const &bin_path, import_table &table) {
+  auto f = std::make_unique<mapped_file>(bin_path);
+
+  auto ident = at<unsigned char>(*f, 0, EI_NIDENT);
+  if (std::memcmp(ident, ELFMAG, SELFMAG) != 0) {
+    throw std::runtime_error("bad binary header");
+  }
+
+  constexpr unsigned char host_data =
+      (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) ? ELFDATA2LSB : ELFDATA2MSB;
+  if (ident[EI_DATA] != host_data) {
+    throw std::runtime_error("unsupported byte order");
+  }
+
+  std::vector<parsed_import> imports;
+  if (ident[EI_CLASS] == elf64::elf_class) {
+    imports = parse<elf64>(*f);
+  } else if (ident[EI_CLASS] == elf32::elf_class) {
+    imports = parse<elf32>(*f);
+  } else {
+    throw std::runtime_error("bad binary class");
+  }
+
+  // the table owns the mapping before holding any view into it
+  auto file = static_cast<std::uint32_t>(table.files.size());
+  table.files.push_back(std::move(f));
+  table.paths.push_back(bin_path);
+  for (auto const &imp : imports) {
+    table.entries.push_back(
+        {imp.name, imp.version, table.modules.intern(imp.module), file});
+  }
+}
+
+// entries as a record source, mod= rules are checked once per module and
+// answered with the entries of the matching modules
+class import_source final : public record_source {
+  import_table const &_table;
+  entry_list const &_raw;
+  std::string_view &_mod;
+  std::string_view &_name;
+  std::string_view &_ver;
+  std::vector<record_set> _by_module;
+
+public:
+  import_source(import_table const &table, entry_list const &raw,
+                std::string_view &mod, std::string_view &name,
+                std::string_view &ver)
+      : _table{table}, _raw{raw}, _mod{mod}, _name{name}, _ver{ver},
+        _by_module(table.modules.size()) {
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+      _by_module[raw[i].module].push_back(i);
+    }
+  }
+
+  std::size_t size() const override { return _raw.size(); }
+
+  pushed_leaf push(rule_expr const &leaf) override {
+    pushed_leaf p;
+    if (leaf.rule().rfind("mod=", 0) != 0) {
+      return p;
+    }
+
+    p.type = pushdown_type::EXACT;
+    for (std::uint32_t m = 0; m < _by_module.size(); ++m) {
+      _mod = _table.modules.name(m);
+      if (!_by_module[m].empty() && leaf.interpret()) {
+        p.records.insert(std::end(p.records), std::cbegin(_by_module[m]),
+                         std::cend(_by_module[m]));
+      }
+    }
+    std::sort(std::begin(p.records), std::end(p.records));
+    return p;
+  }
+
+  void load(std::size_t record) override {
+    auto const &r = _raw[record];
+    _mod = _table.modules.name(r.module);
+    _name = r.name;
+    _ver = r.version;
+  }
+};
+
+// apply rule
+auto filter(import_table const &table, entry_list const &raw,
+            std::string const &filter) {
+  // current entry fields that serve as reference in rules
+  std::string_view mod;
+  std::string_view name;
+  std::string_view ver;
+  auto mod_rule = regex_rule{"mod=(.*)", mod};
+  auto name_rule = regex_rule{"name=(.*)", name};
+  auto ver_rule = regex_rule{"ver=(.*)", ver};
+
+  lexer lexer{filter};
+  parser parser{
+      lexer,
+      std::vector<parser::rule_handler>{
+          {[&rule = mod_rule](auto const &str) { return rule.do_handle(str); },
+           [&rule = mod_rule](auto const &str) { return rule.interpret(str); }},
+          {[&rule = name_rule](auto const &str) { return rule.do_handle(str); },
+           [&rule = name_rule](auto const &str) {
+             return rule.interpret(str);
+           }},
+          {[&rule = ver_rule](auto const &str) { return rule.do_handle(str); },
+           [&rule = ver_rule](auto const &str) {
+             return rule.interpret(str);
+           }}}};
+
+  // versions and names repeat across modules and binaries, their rules
+  // remember their result per value
+  auto expr = std::make_unique<memo_expr>(
+      parser.build(), [&](rule_expr const &leaf) -> field_reader {
+        if (leaf.rule().rfind("ver=", 0) == 0) {
+          return [&ver] { return ver; };
+        }
+        if (leaf.rule().rfind("name=", 0) == 0) {
+          return [&name] { return name; };
+        }
+        return {};
+      });
+
+  // mod= rules are answered by the source, only entries of the matching
+  // modules are checked against the other rules
+  import_source source{table, raw, mod, name, ver};
+  auto res = pushdown_filter(*expr, source);
+
+  entry_list filtered;
+  filtered.reserve(res.matches.size());
+  for (auto i : res.matches) {
+    filtered.push_back(raw[i]);
+  }
+
+  std::cout << "[pushdown] " << res.pushed << " rules pushed, " << res.loaded
+            << " of " << raw.size() << " entries loaded" << std::endl;
+  for (auto const &st : expr->stats()) {
+    std::cout << "[memo] " << st.rule << ": " << st.hits << " hits, "
+              << st.misses << " misses" << std::endl;
+  }
+
+  return filtered;
+}
+
+void sort_imports(import_table const &table, entry_list &list) {
+  auto rank = table.modules.ranks();
+  std::sort(std::begin(list), std::end(list),
+            [&rank](auto const &r1, auto const &r2) {
+              if (r1.file != r2.file) {
+                return r1.file < r2.file;
+              }
+              if (r1.module != r2.module) {
+                return rank[r1.module] < rank[r2.module];
+              }
+              return r1.name < r2.name;
+            });
+}
+
+// display filtered result
+void display(import_table const &table, entry_list const &list) {
+  std::cout << "\n----------IMPORTS----------" << std::endl;
+
+  auto file = table.files.size();
+  for (const auto &e : list) {
+    if (e.file != file && table.files.size() > 1) {
+      std::cout << "[file] " << table.paths[e.file] << std::endl;
+    }
+    file = e.file;
+
+    std::cout << "[entry] " << table.modules.name(e.module) << "::" << e.name;
+    if (!e.version.empty()) {
+      std::cout << "@" << e.version;
+    }
+    std::cout << std::endl;
+  }
+
+  std::cout << "[" << list.size() << " entries]" << std::endl;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "[-][elfimp] usage: elfimp bin_path..." << std::endl;
+    return 1;
+  }
+
+  std::cout << "---------- Welcome to elf import explorer ----------"
+            << std::endl;
+  std::cout << "usage:" << std::endl;
+  std::cout << " - enabled rules are: mod=.*, name=.* and ver=.*" << std::endl;
+  std::cout << " - example: 'mod=libc.*' & 'name=str.*'" << std::endl;
+  std::cout << "----------------------------------------------------"
+            << std::endl;
+
+  import_table table;
+  for (int i = 1; i < argc; ++i) {
+    try {
+      build(argv[i], table);
+    } catch (const std::exception &e) {
+      std::cerr << "[-][elfimp] " << argv[i]
+                << " loading failed with error : " << e.what() << std::endl;
+    }
+  }
+  sort_imports(table, table.entries);
+
+  const std::string query =
+      "\nenter a filter, f for full imports or q to quit: ";
+  for (std::string in = (std::cout << query, "");
+       std::getline(std::cin, in) && in != "q"; std::cout << query) {
+    try {
+      if (in == "f") {
+        display(table, table.entries);
+      } else {
+        // sorted input stays sorted once filtered
+        display(table, filter(table, table.entries, in));
+      }
+    } catch (const std::exception &e) {
+      std::cerr << "[-][elfimp] failed with error : " << e.what() << std::endl;
+    }
+  }
+
+  return 0;
+}
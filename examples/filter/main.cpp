@@ -0,0 +1,840 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "nforce/expr.h"
+#include "nforce/lexer.h"
+#include "nforce/parser.h"
+#include "nforce/prefilter.h"
+
+using namespace n4;
+
+//
+// Linux example used to filter newline-delimited records (raw lines,
+// key=value pairs, csv or json lines) and measure end-to-end throughput
+//
+// Input is mmap'd when possible and read by large blocks otherwise. Each
+// block is split into chunks evaluated by worker threads that own their
+// own expression while the main thread writes matching records in input
+// order, straight from the input buffer.
+//
+
+namespace {
+enum class format_type { RAW = 0, KV, CSV, JSON };
+
+struct options {
+  format_type format{format_type::RAW};
+  char delim{','};
+  std::size_t threads{std::max(1u, std::thread::hardware_concurrency())};
+  std::size_t chunk_size{1 << 20};
+  std::size_t block_size{64 << 20};
+  bool quiet{false};
+  bool prefilter{true};
+  std::string filter;
+  std::string path;
+};
+
+struct stats {
+  std::size_t records{0};
+  std::size_t matches{0};
+  std::size_t rejected{0};
+  std::size_t bytes{0};
+};
+
+// record layout shared by all workers
+struct layout {
+  format_type format{format_type::RAW};
+  char delim{','};
+  std::vector<std::string> header;
+};
+
+//-------------------------------------
+// Field extraction
+
+constexpr std::string_view line_field{"line"};
+
+bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+std::string_view trim(std::string_view sv) {
+  while (!sv.empty() && is_blank(sv.front())) {
+    sv.remove_prefix(1);
+  }
+  while (!sv.empty() && is_blank(sv.back())) {
+    sv.remove_suffix(1);
+  }
+  return sv;
+}
+
+std::string_view unquote(std::string_view sv) {
+  sv = trim(sv);
+  if (sv.size() >= 2 && sv.front() == '"' && sv.back() == '"') {
+    return sv.substr(1, sv.size() - 2);
+  }
+  return sv;
+}
+
+// key1=value1 key2="value 2"
+std::optional<std::string_view> kv_field(std::string_view line,
+                                         std::string_view key) {
+  std::size_t pos = 0;
+  while (pos < line.size()) {
+    while (pos < line.size() && is_blank(line[pos])) {
+      ++pos;
+    }
+
+    auto eq = line.find('=', pos);
+    if (eq == std::string_view::npos) {
+      return std::nullopt;
+    }
+
+    auto vbeg = eq + 1;
+    auto vend = vbeg;
+    if (vbeg < line.size() && line[vbeg] == '"') {
+      vend = line.find('"', vbeg + 1);
+      vend = (vend == std::string_view::npos) ? line.size() : vend + 1;
+    } else {
+      while (vend < line.size() && !is_blank(line[vend])) {
+        ++vend;
+      }
+    }
+
+    if (line.substr(pos, eq - pos) == key) {
+      return unquote(line.substr(vbeg, vend - vbeg));
+    }
+
+    pos = vend;
+  }
+
+  return std::nullopt;
+}
+
+// a,"b,c",d
+std::vector<std::string_view> csv_split(std::string_view line, char delim) {
+  std::vector<std::string_view> fields;
+  std::size_t beg = 0;
+  bool quoted = false;
+  for (std::size_t i = 0; i < line.size(); ++i) {
+    if (line[i] == '"') {
+      quoted = !quoted;
+    } else if (line[i] == delim && !quoted) {
+      fields.push_back(unquote(line.substr(beg, i - beg)));
+      beg = i + 1;
+    }
+  }
+  fields.push_back(unquote(line.substr(beg)));
+  return fields;
+}
+
+std::optional<std::string_view> csv_field(std::string_view line,
+                                          std::size_t column, char delim) {
+  std::size_t beg = 0;
+  std::size_t index = 0;
+  bool quoted = false;
+  for (std::size_t i = 0; i <= line.size(); ++i) {
+    if (i < line.size() && line[i] == '"') {
+      quoted = !quoted;
+    } else if (i == line.size() || (line[i] == delim && !quoted)) {
+      if (index++ == column) {
+        return unquote(line.substr(beg, i - beg));
+      }
+      beg = i + 1;
+    }
+  }
+
+  return std::nullopt;
+}
+
+// {"key": "value", "n": 12, "o": {...}} (top level keys only)
+std::size_t json_skip_string(std::string_view line, std::size_t pos) {
+  for (++pos; pos < line.size() && line[pos] != '"'; ++pos) {
+    if (line[pos] == '\\') {
+      ++pos;
+    }
+  }
+  return std::min(pos + 1, line.size());
+}
+
+std::size_t json_skip_value(std::string_view line, std::size_t pos) {
+  int depth = 0;
+  for (; pos < line.size(); ++pos) {
+    auto c = line[pos];
+    if (c == '"') {
+      pos = json_skip_string(line, pos) - 1;
+    } else if (c == '{' || c == '[') {
+      ++depth;
+    } else if (c == '}' || c == ']') {
+      if (depth-- == 0) {
+        break;
+      }
+    } else if (c == ',' && depth == 0) {
+      break;
+    }
+  }
+  return pos;
+}
+
+std::optional<std::string_view> json_field(std::string_view line,
+                                           std::string_view key) {
+  auto pos = line.find('{');
+  if (pos == std::string_view::npos) {
+    return std::nullopt;
+  }
+
+  while (++pos < line.size()) {
+    while (pos < line.size() && line[pos] != '"' && line[pos] != '}') {
+      ++pos;
+    }
+    if (pos >= line.size() || line[pos] == '}') {
+      return std::nullopt;
+    }
+
+    auto kend = json_skip_string(line, pos);
+    auto name = line.substr(pos + 1, kend - pos - 2);
+
+    auto colon = line.find(':', kend);
+    if (colon == std::string_view::npos) {
+      return std::nullopt;
+    }
+
+    auto vend = json_skip_value(line, colon + 1);
+    if (name == key) {
+      return unquote(line.substr(colon + 1, vend - colon - 1));
+    }
+
+    pos = vend;
+  }
+
+  return std::nullopt;
+}
+
+//-------------------------------------
+// Rules
+
+// generic field rule: field=regex (full match) or field~text (contains)
+class field_rule {
+  struct matcher {
+    std::string field;
+    std::size_t column{0};
+    bool is_regex{false};
+    std::regex regx;
+    std::string text;
+  };
+
+  const layout &_layout;
+  const std::string_view &_rec;
+  std::unordered_map<std::string, matcher> _matchers;
+
+  std::optional<std::string_view> field(const matcher &m) const {
+    if (m.field == line_field) {
+      return _rec;
+    }
+
+    switch (_layout.format) {
+    case format_type::KV:
+      return kv_field(_rec, m.field);
+    case format_type::CSV:
+      return csv_field(_rec, m.column, _layout.delim);
+    case format_type::JSON:
+      return json_field(_rec, m.field);
+    default:
+      return std::nullopt;
+    }
+  }
+
+public:
+  field_rule(const layout &l, const std::string_view &rec)
+      : _layout{l}, _rec{rec} {}
+
+  bool do_handle(std::string const &str) {
+    if (_matchers.count(str)) {
+      return true;
+    }
+
+    auto op = str.find_first_of("=~");
+    if (op == 0 || op == std::string::npos) {
+      return false;
+    }
+
+    matcher m;
+    m.field = str.substr(0, op);
+    m.is_regex = (str[op] == '=');
+
+    if (m.field != line_field) {
+      if (_layout.format == format_type::RAW) {
+        return false;
+      }
+
+      if (_layout.format == format_type::CSV) {
+        auto hit = std::find(std::cbegin(_layout.header),
+                             std::cend(_layout.header), m.field);
+        if (hit == std::cend(_layout.header)) {
+          return false;
+        }
+        m.column = std::distance(std::cbegin(_layout.header), hit);
+      }
+    }
+
+    m.text = str.substr(op + 1);
+    if (m.is_regex) {
+      try {
+        m.regx = std::regex{m.text, std::regex::optimize};
+      } catch (std::regex_error const &) {
+        return false;
+      }
+    }
+
+    _matchers.emplace(str, std::move(m));
+    return true;
+  }
+
+  bool interpret(std::string const &str) const {
+    auto hit = _matchers.find(str);
+    if (hit == std::cend(_matchers)) {
+      throw std::runtime_error("unknown rule " + str);
+    }
+
+    const auto &m = hit->second;
+    auto value = field(m);
+    if (!value) {
+      return false;
+    }
+
+    if (m.is_regex) {
+      return std::regex_match(value->begin(), value->end(), m.regx);
+    }
+
+    return value->find(m.text) != std::string_view::npos;
+  }
+
+  // fields are plain slices of the record, so are the literals they need
+  std::vector<std::string> literals(std::string const &str) const {
+    auto hit = _matchers.find(str);
+    if (hit == std::cend(_matchers)) {
+      return {};
+    }
+
+    const auto &m = hit->second;
+    return m.is_regex ? regex_literals(m.text)
+                      : std::vector<std::string>{m.text};
+  }
+};
+
+// per-worker evaluation state
+class evaluator {
+  std::string_view _rec;
+  field_rule _rule;
+  std::unique_ptr<expr> _expr;
+  std::optional<prefilter> _prefilter;
+
+public:
+  evaluator(const layout &l, const options &opts) : _rule{l, _rec} {
+    lexer lexer{opts.filter};
+    parser parser{
+        lexer, std::vector<parser::rule_handler>{
+                   {[&rule = _rule](auto const &str) {
+                      return rule.do_handle(str);
+                    },
+                    [&rule = _rule](auto const &str) {
+                      return rule.interpret(str);
+                    }}}};
+
+    _expr = parser.build();
+    if (opts.prefilter) {
+      _prefilter.emplace(*_expr, [&rule = _rule](const rule_expr &e) {
+        return rule.literals(e.rule());
+      });
+    }
+  }
+
+  // false if the record cannot match, without calling the rules
+  bool may_match(std::string_view rec) const {
+    return !_prefilter || _prefilter->may_match(rec);
+  }
+
+  bool operator()(std::string_view rec) {
+    _rec = rec;
+    return _expr->interpret();
+  }
+};
+
+//-------------------------------------
+// Pipeline
+
+// worker pool evaluating the chunks of a block, output is kept ordered
+class pipeline {
+  struct chunk {
+    explicit chunk(std::string_view d) : data{d} {}
+
+    std::string_view data;
+    std::vector<iovec> out;
+    std::size_t records{0};
+    std::size_t matches{0};
+    std::size_t rejected{0};
+    bool done{false};
+  };
+
+  const options &_opts;
+  std::vector<std::thread> _workers;
+  std::vector<chunk> _chunks;
+  std::exception_ptr _error;
+  std::size_t _next{0};
+  std::size_t _written{0};
+  std::size_t _window{0};
+  bool _stop{false};
+  std::mutex _mutex;
+  std::condition_variable _cv;
+
+  static constexpr char _newline = '\n';
+
+  void evaluate(evaluator &eval, chunk &c) {
+    auto it = c.data.data();
+    auto end = it + c.data.size();
+    while (it < end) {
+      auto eol = static_cast<const char *>(std::memchr(it, '\n', end - it));
+      auto next = eol ? eol + 1 : end;
+      auto rec = std::string_view(it, (eol ? eol : end) - it);
+
+      if (!eval.may_match(rec)) {
+        ++c.rejected;
+      } else if (eval(rec)) {
+        c.out.push_back({const_cast<char *>(it),
+                         static_cast<std::size_t>(next - it)});
+        if (!eol) {
+          c.out.push_back({const_cast<char *>(&_newline), 1});
+        }
+        ++c.matches;
+      }
+
+      ++c.records;
+      it = next;
+    }
+  }
+
+  void work(const layout &l) {
+    std::optional<evaluator> eval;
+    std::exception_ptr error;
+    try {
+      eval.emplace(l, _opts);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::unique_lock<std::mutex> lock{_mutex};
+    for (;;) {
+      _cv.wait(lock, [this] {
+        return _stop ||
+               (_next < _chunks.size() && _next < _written + _window);
+      });
+
+      if (_stop) {
+        return;
+      }
+
+      auto &c = _chunks[_next++];
+      lock.unlock();
+
+      if (!error) {
+        try {
+          evaluate(*eval, c);
+        } catch (...) {
+          error = std::current_exception();
+        }
+      }
+
+      lock.lock();
+      if (error && !_error) {
+        _error = error;
+      }
+      c.done = true;
+      _cv.notify_all();
+    }
+  }
+
+  void write(std::vector<iovec> &out) {
+    for (std::size_t i = 0; i < out.size(); i += IOV_MAX) {
+      auto cnt = std::min<std::size_t>(IOV_MAX, out.size() - i);
+      auto len = std::size_t{0};
+      for (std::size_t j = i; j < i + cnt; ++j) {
+        len += out[j].iov_len;
+      }
+
+      // writev may be partial on pipes, fall back to plain writes
+      auto res = ::writev(STDOUT_FILENO, &out[i], static_cast<int>(cnt));
+      if (res < 0) {
+        throw std::runtime_error(std::string("write failed: ") +
+                                 std::strerror(errno));
+      }
+
+      auto done = static_cast<std::size_t>(res);
+      for (std::size_t j = i; j < i + cnt && done < len; ++j) {
+        if (done >= out[j].iov_len) {
+          done -= out[j].iov_len;
+          continue;
+        }
+
+        auto ptr = static_cast<const char *>(out[j].iov_base) + done;
+        auto left = out[j].iov_len - done;
+        while (left) {
+          auto w = ::write(STDOUT_FILENO, ptr, left);
+          if (w < 0) {
+            throw std::runtime_error(std::string("write failed: ") +
+                                     std::strerror(errno));
+          }
+          ptr += w;
+          left -= static_cast<std::size_t>(w);
+        }
+        done = 0;
+      }
+    }
+  }
+
+public:
+  pipeline(const options &opts, const layout &l)
+      : _opts{opts}, _window{4 * opts.threads} {
+    // report filter errors before any input is processed
+    evaluator{l, opts};
+
+    for (std::size_t i = 0; i < opts.threads; ++i) {
+      _workers.emplace_back([this, &l] { this->work(l); });
+    }
+  }
+
+  ~pipeline() {
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      _stop = true;
+    }
+    _cv.notify_all();
+    for (auto &w : _workers) {
+      w.join();
+    }
+  }
+
+  void run(std::string_view block, stats &st) {
+    std::vector<chunk> chunks;
+    while (!block.empty()) {
+      auto len = std::min(_opts.chunk_size, block.size());
+      auto eol = block.find('\n', len - 1);
+      len = (eol == std::string_view::npos) ? block.size() : eol + 1;
+      chunks.emplace_back(block.substr(0, len));
+      block.remove_prefix(len);
+    }
+
+    std::unique_lock<std::mutex> lock{_mutex};
+    _chunks = std::move(chunks);
+    _next = 0;
+    _written = 0;
+    _cv.notify_all();
+
+    for (std::size_t i = 0; i < _chunks.size(); ++i) {
+      _cv.wait(lock, [&] { return _chunks[i].done; });
+
+      if (_error) {
+        // stop handing out chunks and let workers finish the claimed ones
+        // before releasing them
+        auto claimed = _next;
+        _next = _chunks.size();
+        _cv.wait(lock, [&] {
+          return std::all_of(_chunks.begin(), _chunks.begin() + claimed,
+                             [](const chunk &c) { return c.done; });
+        });
+        _chunks.clear();
+        _next = 0;
+        std::rethrow_exception(_error);
+      }
+
+      auto out = std::move(_chunks[i].out);
+      st.records += _chunks[i].records;
+      st.matches += _chunks[i].matches;
+      st.rejected += _chunks[i].rejected;
+      st.bytes += _chunks[i].data.size();
+      lock.unlock();
+
+      if (!_opts.quiet) {
+        write(out);
+      }
+
+      lock.lock();
+      _written = i + 1;
+      _cv.notify_all();
+    }
+
+    _chunks.clear();
+  }
+};
+
+//-------------------------------------
+// Input
+
+// mmap'd regular file
+class mapped_file {
+  int _fd{-1};
+  void *_addr{MAP_FAILED};
+  std::size_t _size{0};
+
+public:
+  explicit mapped_file(int fd) : _fd{fd} {
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+      return;
+    }
+
+    _size = static_cast<std::size_t>(st.st_size);
+    _addr = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (_addr != MAP_FAILED) {
+      ::madvise(_addr, _size, MADV_SEQUENTIAL);
+    }
+  }
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  ~mapped_file() {
+    if (_addr != MAP_FAILED) {
+      ::munmap(_addr, _size);
+    }
+  }
+
+  bool valid() const { return _addr != MAP_FAILED; }
+
+  std::string_view data() const {
+    return {static_cast<const char *>(_addr), _size};
+  }
+};
+
+// split header line from csv input
+std::string_view take_header(std::string_view &block, layout &l) {
+  auto eol = block.find('\n');
+  auto line = block.substr(0, eol);
+  block.remove_prefix(eol == std::string_view::npos ? block.size() : eol + 1);
+
+  for (auto f : csv_split(trim(line), l.delim)) {
+    l.header.emplace_back(f);
+  }
+
+  return line;
+}
+
+stats run(const options &opts, int fd) {
+  stats st;
+  layout l{opts.format, opts.delim, {}};
+
+  auto emit_header = [&](std::string_view h) {
+    if (!opts.quiet && !h.empty()) {
+      std::cout << h << std::endl;
+    }
+  };
+
+  mapped_file file{fd};
+  if (file.valid()) {
+    auto block = file.data();
+    auto header = (l.format == format_type::CSV) ? take_header(block, l)
+                                                 : std::string_view{};
+
+    pipeline p{opts, l};
+    emit_header(header);
+    p.run(block, st);
+    return st;
+  }
+
+  // fall back to large buffered reads, carrying the last partial line
+  std::vector<char> buffer(opts.block_size);
+  std::optional<pipeline> p;
+  std::size_t used = 0;
+  bool eof = false;
+  while (!eof) {
+    if (used == buffer.size()) {
+      buffer.resize(buffer.size() * 2);
+    }
+
+    auto n = ::read(fd, buffer.data() + used, buffer.size() - used);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("read failed: ") +
+                               std::strerror(errno));
+    }
+
+    eof = (n == 0);
+    used += static_cast<std::size_t>(n);
+    if (!eof && used < buffer.size()) {
+      continue;
+    }
+
+    auto block = std::string_view(buffer.data(), used);
+    if (!p) {
+      std::string_view header;
+      if (l.format == format_type::CSV) {
+        if (!eof && block.find('\n') == std::string_view::npos) {
+          continue;
+        }
+        header = take_header(block, l);
+      }
+      p.emplace(opts, l);
+      emit_header(header);
+    }
+
+    auto last = eof ? block.size() : block.rfind('\n') + 1;
+    if (last == 0 && !eof) {
+      continue;
+    }
+
+    p->run(block.substr(0, last), st);
+
+    auto rest = block.size() - last;
+    std::memmove(buffer.data(), block.data() + last, rest);
+    used = rest;
+  }
+
+  return st;
+}
+
+void usage() {
+  std::cerr << "[-][nfilter] usage: nfilter [-f raw|kv|csv|json] [-d delim] "
+               "[-j threads] [-c chunk_kib] [-q] [-n] filter [file]"
+            << std::endl;
+  std::cerr << " - enabled rules are: field=regex and field~text" << std::endl;
+  std::cerr << " - field 'line' always denotes the full record" << std::endl;
+  std::cerr << " - -n disables the required literal prefilter" << std::endl;
+  std::cerr << " - example: 'level=warn|error' & 'msg~timeout'" << std::endl;
+}
+
+std::optional<options> parse_options(int argc, char **argv) {
+  options opts;
+  int c;
+  while ((c = ::getopt(argc, argv, "f:d:j:c:qnh")) != -1) {
+    switch (c) {
+    case 'f': {
+      std::string f{optarg};
+      if (f == "raw") {
+        opts.format = format_type::RAW;
+      } else if (f == "kv") {
+        opts.format = format_type::KV;
+      } else if (f == "csv") {
+        opts.format = format_type::CSV;
+      } else if (f == "json") {
+        opts.format = format_type::JSON;
+      } else {
+        return std::nullopt;
+      }
+      break;
+    }
+    case 'd':
+      if (std::strlen(optarg) != 1) {
+        return std::nullopt;
+      }
+      opts.delim = optarg[0];
+      break;
+    case 'j':
+      opts.threads = std::max(1ul, std::stoul(optarg));
+      break;
+    case 'c':
+      opts.chunk_size = std::max(1ul, std::stoul(optarg)) << 10;
+      break;
+    case 'q':
+      opts.quiet = true;
+      break;
+    case 'n':
+      opts.prefilter = false;
+      break;
+    default:
+      return std::nullopt;
+    }
+  }
+
+  if (optind == argc || argc - optind > 2) {
+    return std::nullopt;
+  }
+
+  opts.filter = argv[optind];
+  if (optind + 1 < argc) {
+    opts.path = argv[optind + 1];
+  }
+
+  return opts;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  std::optional<options> opts;
+  try {
+    opts = parse_options(argc, argv);
+  } catch (const std::exception &) {
+  }
+
+  if (!opts) {
+    usage();
+    return 1;
+  }
+
+  int fd = STDIN_FILENO;
+  if (!opts->path.empty() && (fd = ::open(opts->path.c_str(), O_RDONLY)) < 0) {
+    std::cerr << "[-][nfilter] cannot open " << opts->path << std::endl;
+    return 1;
+  }
+
+  std::ios::sync_with_stdio(false);
+
+  stats st;
+  auto start = std::chrono::steady_clock::now();
+  try {
+    st = run(*opts, fd);
+  } catch (const nexcept &e) {
+    std::cerr << "[-][nfilter] invalid filter (status "
+              << static_cast<int>(e.status()) << ")" << std::endl;
+    return 1;
+  } catch (const std::exception &e) {
+    std::cerr << "[-][nfilter] failed with error : " << e.what() << std::endl;
+    return 1;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  if (fd != STDIN_FILENO) {
+    ::close(fd);
+  }
+
+  auto secs = std::max(elapsed.count(), 1e-9);
+  std::cerr << "[+][nfilter] " << st.records << " records, " << st.matches
+            << " matched, " << st.rejected << " prefiltered, " << st.bytes
+            << " bytes in " << secs << " s ("
+            << static_cast<std::size_t>(st.records / secs) << " records/s, "
+            << (st.bytes / secs) / (1 << 20) << " MiB/s)" << std::endl;
+
+  return 0;
+}
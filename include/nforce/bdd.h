@@ -0,0 +1,100 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "nforce/expr.h"
+#include "nforce/leaves.h"
+
+namespace n4 {
+///
+/// @brief Expression compiled into a reduced ordered binary decision diagram
+///
+/// Interpretation follows a single decision path from the root so that
+/// each distinct leaf is evaluated at most once and only when it can still
+/// change the result.
+///
+/// Leaves are ordered by increasing cost hint, then by decreasing number
+/// of occurrences in the expression, then by first occurrence.
+///
+class bdd_expr final : public expr {
+public:
+  using cost_hint = std::function<double(const rule_expr &)>;
+
+  static constexpr std::size_t default_max_nodes = 4096;
+
+  ///
+  /// @brief Contructor of decision diagram
+  /// @param[in] root expression to compile
+  /// @param[in] max_nodes maximum number of nodes created during compilation
+  /// @param[in] cost optional evaluation cost of leaves
+  /// @throw Exception on incomplete expression or, with an internal error
+  ///        status, when the diagram grows over max_nodes, root is left
+  ///        untouched in that case
+  ///
+  explicit bdd_expr(std::unique_ptr<expr> &&root,
+                    std::size_t max_nodes = default_max_nodes,
+                    const cost_hint &cost = nullptr);
+
+  bool interpret() const override;
+
+  void accept(expr_visitor &v) const override { m_root->accept(v); }
+
+  ///
+  /// @brief Number of decision nodes (terminals excluded)
+  ///
+  std::size_t node_count() const { return m_nodes.size() - 2; }
+
+  const leaf_set &leaves() const { return m_leaves; }
+
+  ///
+  /// @brief Leaf evaluation order, as indices of leaves()
+  ///
+  const std::vector<std::size_t> &order() const { return m_order; }
+
+private:
+  struct node {
+    std::uint32_t level;
+    std::uint32_t low;
+    std::uint32_t high;
+  };
+
+  std::unique_ptr<expr> m_root;
+  leaf_set m_leaves;
+  std::vector<std::size_t> m_order;
+  std::vector<const rule_expr *> m_levels;
+  std::vector<node> m_nodes;
+  std::uint32_t m_start{0};
+
+  friend class bdd_builder;
+};
+
+///
+/// @brief Compile expression into a decision diagram when it stays small
+/// @param[in] root expression to compile
+/// @param[in] max_nodes maximum number of nodes created during compilation
+/// @param[in] cost optional evaluation cost of leaves
+/// @return decision diagram expression or root itself if it is too large
+///
+std::unique_ptr<expr>
+compile_bdd(std::unique_ptr<expr> root,
+            std::size_t max_nodes = bdd_expr::default_max_nodes,
+            const bdd_expr::cost_hint &cost = nullptr);
+} // namespace n4
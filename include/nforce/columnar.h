@@ -0,0 +1,153 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "nforce/leaves.h"
+#include "nforce/parser.h"
+
+namespace n4 {
+///
+/// @brief Comparison of a column value with a rule constant
+///
+/// Rules are written field<op>constant with op among ==, !=, <, <=, >, >=
+/// for integer columns and ==, != , ^= (prefix), *= (contains) for string
+/// columns.
+///
+enum class column_op_type { EQ = 0, NE, LT, LE, GT, GE, PREFIX, CONTAINS };
+
+///
+/// @brief Non-owning columnar record storage
+///
+/// Integer columns are arrays of rows() values, string columns are arrays
+/// of rows() + 1 offsets into a byte buffer, value i spanning
+/// [offsets[i], offsets[i + 1]).
+///
+class column_set final {
+public:
+  struct column {
+    const std::int64_t *values{nullptr};
+    const std::uint32_t *offsets{nullptr};
+    const char *bytes{nullptr};
+  };
+
+  struct rule {
+    const column *col{nullptr};
+    column_op_type op{column_op_type::EQ};
+    std::int64_t value{0};
+    std::string text;
+  };
+
+  explicit column_set(std::size_t rows) : m_rows{rows} {}
+
+  std::size_t rows() const { return m_rows; }
+
+  void add(const std::string &name, const std::int64_t *values);
+  void add(const std::string &name, const std::uint32_t *offsets,
+           const char *bytes);
+
+  const column *find(const std::string &name) const;
+
+  ///
+  /// @brief Parse a rule against the columns
+  /// @return false if the rule does not apply to any column
+  ///
+  bool parse(const std::string &str, rule &r) const;
+
+  ///
+  /// @brief Handler evaluating rules on a single row
+  /// @param[in] row row to evaluate, must outlive the built expression
+  ///
+  parser::rule_handler handler(const std::size_t &row) const;
+
+private:
+  std::size_t m_rows;
+  std::unordered_map<std::string, column> m_columns;
+};
+
+///
+/// @brief Match bitmap, row i of a scan being bit i % 64 of word i / 64
+///
+using bitmap = std::vector<std::uint64_t>;
+
+struct columnar_options {
+  /// use avx2 kernels when supported by the cpu
+  bool simd{true};
+  /// rows evaluated per step, bounding the size of temporary bitmaps
+  std::size_t block_rows{4096};
+};
+
+///
+/// @brief Expression evaluated over column slices
+///
+/// Each distinct leaf is compiled into a comparison kernel producing the
+/// match bitmap of a block of rows, bitmaps being then combined following
+/// the boolean structure of the expression.
+///
+class columnar_scan final {
+public:
+  ///
+  /// @brief Contructor of columnar scan
+  /// @param[in] root expression whose leaves are column rules
+  /// @param[in] cols columns to scan, must outlive the scan
+  /// @param[in] opts scan options
+  /// @throw Exception on incomplete expression or non column rule
+  ///
+  columnar_scan(const expr &root, const column_set &cols,
+                const columnar_options &opts = {});
+  ~columnar_scan();
+
+  ///
+  /// @brief Evaluate rows [first, first + count)
+  /// @param[out] out match bitmap of the slice, resized to fit count bits
+  ///
+  void scan(std::size_t first, std::size_t count, bitmap &out) const;
+
+  ///
+  /// @brief Evaluate all rows
+  ///
+  bitmap scan() const;
+
+  ///
+  /// @brief Check if avx2 kernels are used
+  ///
+  bool simd() const { return m_simd; }
+
+private:
+  struct instr;
+
+  const column_set &m_cols;
+  leaf_set m_leaves;
+  std::vector<column_set::rule> m_rules;
+  std::vector<instr> m_program;
+  std::size_t m_depth{0};
+  std::size_t m_block_words{0};
+  bool m_simd{false};
+
+  friend class columnar_compiler;
+};
+
+///
+/// @brief Number of set bits of the first count bits of a bitmap
+///
+std::size_t match_count(const bitmap &bits, std::size_t count);
+} // namespace n4
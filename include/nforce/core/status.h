@@ -23,6 +23,7 @@ enum class status_type : uint16_t {
   BAD_AST,
   BAD_PARSE,
   INTERNAL_ERROR,
-  UNKNOWN_ERROR
+  UNKNOWN_ERROR,
+  OVER_BUDGET
 };
 }
\ No newline at end of file
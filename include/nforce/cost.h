@@ -0,0 +1,65 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+
+namespace n4 {
+class expr;
+
+///
+/// @brief Static cost of an expression
+///
+struct expr_cost {
+  /// number of nodes
+  std::size_t nodes{0};
+  /// number of nodes on the longest path from the root to a leaf
+  std::size_t depth{0};
+  /// number of distinct leaves
+  std::size_t leaves{0};
+  /// cost of an evaluation checking every leaf
+  double worst{0.0};
+  /// average cost of an evaluation, leaves being assumed independent
+  double expected{0.0};
+};
+
+///
+/// @brief Upper limits of an expression cost, 0 for no limit
+///
+struct cost_budget {
+  std::size_t nodes{0};
+  std::size_t depth{0};
+  std::size_t leaves{0};
+  double worst{0.0};
+  double expected{0.0};
+};
+
+///
+/// @brief Static cost of an expression from the cost hints of its leaves
+///
+/// Expected costs account for short-circuits using the selectivity hints
+/// of the leaves, an operand only being evaluated when the previous ones
+/// did not decide their node.
+///
+/// @param[in] root expression to analyze
+/// @throw Exception on incomplete expression
+///
+expr_cost static_cost(const expr &root);
+
+///
+/// @brief Check that a cost fits a budget
+///
+bool within(const expr_cost &cost, const cost_budget &budget);
+} // namespace n4
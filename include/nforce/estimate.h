@@ -0,0 +1,98 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace n4 {
+class expr;
+
+///
+/// @brief Materialize a record for the handlers of an expression
+///
+using record_loader = std::function<void(std::size_t)>;
+
+struct estimate_options {
+  /// probability that the bounds hold the exact value
+  double confidence{0.95};
+  /// target half width of the bounds, as a fraction of the range size
+  double precision{0.01};
+  /// number of records evaluated before precision is first checked
+  std::size_t min_sample{64};
+  /// maximum number of records evaluated, 0 for the whole range
+  std::size_t max_sample{0};
+  /// also evaluate every distinct leaf on each sampled record
+  bool leaf_selectivity{false};
+  /// seed of the sample, equal seeds drawing equal samples
+  std::uint64_t seed{0};
+};
+
+///
+/// @brief Estimated fraction of records for which a leaf holds
+///
+struct leaf_estimate {
+  std::string rule;
+  std::size_t matched{0};
+  double selectivity{0.0};
+  double low{0.0};
+  double high{0.0};
+};
+
+///
+/// @brief Estimated number of records matching an expression
+///
+struct count_estimate {
+  /// number of records of the range
+  std::size_t population{0};
+  /// number of records evaluated
+  std::size_t sampled{0};
+  /// number of evaluated records matching
+  std::size_t matched{0};
+  double count{0.0};
+  double low{0.0};
+  double high{0.0};
+  /// per distinct leaf, in leaf_set order, if requested
+  std::vector<leaf_estimate> leaves;
+
+  bool exact() const { return sampled == population; }
+};
+
+///
+/// @brief Estimate the number of records of a range matching an expression
+///
+/// Records are drawn at random without replacement and evaluated until
+/// the bounds are tight enough, the sample is exhausted or the whole range
+/// is evaluated, in which case the count is exact. Bounds are Wilson score
+/// intervals corrected for the finite range size.
+///
+/// Per leaf estimates evaluate each leaf on its own rather than relying
+/// on the expression evaluation, short-circuits otherwise biasing them.
+///
+/// @param[in] root expression to evaluate
+/// @param[in] first first record of the range
+/// @param[in] last record past the end of the range
+/// @param[in] load loads a record before evaluation
+/// @param[in] opts precision and sampling options
+/// @throw Exception on incomplete expression, invalid options or range,
+///        or first exception thrown by a rule or the loader
+///
+count_estimate estimate_count(const expr &root, std::size_t first,
+                              std::size_t last, const record_loader &load,
+                              const estimate_options &opts = {});
+} // namespace n4
@@ -0,0 +1,99 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace n4 {
+///
+/// @brief Work-stealing thread pool
+///
+/// Each worker owns a task queue it pops from the back while idle workers
+/// steal from the front of the others, so that contiguous work submitted
+/// to a worker stays on it unless the load is unbalanced.
+///
+class executor final {
+public:
+  /// task run with the index of the worker running it
+  using task = std::function<void(std::size_t)>;
+
+  ///
+  /// @brief Contructor of executor
+  /// @param[in] threads number of workers, 0 for hardware concurrency
+  ///
+  explicit executor(std::size_t threads = 0);
+  ~executor();
+
+  executor(const executor &) = delete;
+  executor &operator=(const executor &) = delete;
+
+  ///
+  /// @brief Number of workers, worker indices are in [0, size())
+  ///
+  std::size_t size() const { return m_threads.size(); }
+
+  ///
+  /// @brief Number of queued and running tasks
+  ///
+  std::size_t load() const { return m_pending.load() + m_busy.load(); }
+
+  ///
+  /// @brief Queue a task on the next worker (round robin)
+  ///
+  /// An exception escaping the task is discarded, tasks that need to report
+  /// errors must catch them and hand them back to the caller (see bulk).
+  ///
+  void submit(task t);
+
+  ///
+  /// @brief Run f(i, worker) for i in [0, count) and wait for completion
+  /// @throw First exception thrown by f, once all calls are done
+  ///
+  /// Indices are split into contiguous ranges, one per worker queue.
+  ///
+  /// @warning Must not be called from a task of the same executor
+  ///
+  void bulk(std::size_t count,
+            const std::function<void(std::size_t, std::size_t)> &f);
+
+private:
+  struct worker_queue {
+    std::mutex mutex;
+    std::deque<task> tasks;
+  };
+
+  void run(std::size_t w);
+  bool pop(std::size_t w, task &t);
+  void push(std::size_t w, task t);
+  void notify(std::size_t count);
+
+  std::vector<std::unique_ptr<worker_queue>> m_queues;
+  std::vector<std::thread> m_threads;
+  std::atomic<std::size_t> m_pending{0};
+  std::atomic<std::size_t> m_busy{0};
+  std::atomic<std::size_t> m_next{0};
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stop{false};
+};
+} // namespace n4
@@ -17,12 +17,34 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <string>
+#include <vector>
 
 #include "nforce/core/except.h"
 
 namespace n4 {
 enum class binary_op_type { OR = 0, AND };
 
+template <binary_op_type Op> class binary_gen_expr;
+template <binary_op_type Op> class nary_gen_expr;
+class unary_not_expr;
+class rule_expr;
+
+///
+/// @brief Read-only expression tree visitor
+///
+class expr_visitor {
+public:
+  virtual ~expr_visitor() = default;
+
+  virtual void visit(const binary_gen_expr<binary_op_type::OR> &) = 0;
+  virtual void visit(const binary_gen_expr<binary_op_type::AND> &) = 0;
+  virtual void visit(const nary_gen_expr<binary_op_type::OR> &) = 0;
+  virtual void visit(const nary_gen_expr<binary_op_type::AND> &) = 0;
+  virtual void visit(const unary_not_expr &) = 0;
+  virtual void visit(const rule_expr &) = 0;
+};
+
 ///
 /// @brief Base expression
 ///
@@ -34,6 +56,13 @@ public:
   virtual ~expr() = default;
 
   virtual bool interpret() const = 0;
+
+  ///
+  /// @brief Dispatch to the visitor overload matching the node type
+  ///
+  /// @note Compiled forms of an expression forward to their source tree
+  ///
+  virtual void accept(expr_visitor &v) const = 0;
 };
 
 class binary_expr : public expr {
@@ -42,6 +71,11 @@ public:
   virtual void set_right_op(std::unique_ptr<expr> expr) = 0;
 };
 
+class nary_expr : public expr {
+public:
+  virtual void add_op(std::unique_ptr<expr> expr) = 0;
+};
+
 class unary_expr : public expr {
 public:
   virtual void set_op(std::unique_ptr<expr> expr) = 0;
@@ -72,11 +106,64 @@ public:
     m_op2 = std::move(expr);
   }
 
+  void accept(expr_visitor &v) const override { v.visit(*this); }
+
+  const expr *left_op() const { return m_op1.get(); }
+  const expr *right_op() const { return m_op2.get(); }
+
+  std::unique_ptr<expr> release_left_op() { return std::move(m_op1); }
+  std::unique_ptr<expr> release_right_op() { return std::move(m_op2); }
+
 private:
   std::unique_ptr<expr> m_op1;
   std::unique_ptr<expr> m_op2;
 };
 
+///
+/// @brief N-ary boolean expression over a flat list of operands
+///
+/// Associative chains of a same operator are held in a single node so
+/// that their evaluation is a loop with early exit rather than a nest
+/// of binary nodes.
+///
+template <binary_op_type Op> class nary_gen_expr : public nary_expr {
+public:
+  bool interpret() const override {
+    if (m_ops.empty()) {
+      throw nexcept("[nforce] missing n-ary operand", status_type::BAD_AST);
+    }
+
+    // AND stops on first false operand, OR on first true one
+    constexpr bool stop = (Op == binary_op_type::OR);
+    for (const auto &op : m_ops) {
+      if (!op) {
+        throw nexcept("[nforce] missing n-ary operand", status_type::BAD_AST);
+      }
+      if (op->interpret() == stop) {
+        return stop;
+      }
+    }
+    return !stop;
+  }
+
+  void add_op(std::unique_ptr<expr> expr) override {
+    m_ops.push_back(std::move(expr));
+  }
+
+  void accept(expr_visitor &v) const override { v.visit(*this); }
+
+  std::size_t size() const { return m_ops.size(); }
+  const expr *op(std::size_t i) const { return m_ops[i].get(); }
+
+  std::vector<std::unique_ptr<expr>> release_ops() { return std::move(m_ops); }
+
+private:
+  std::vector<std::unique_ptr<expr>> m_ops;
+};
+
+using all_of_expr = nary_gen_expr<binary_op_type::AND>;
+using any_of_expr = nary_gen_expr<binary_op_type::OR>;
+
 ///
 /// @brief Unary boolean expression
 ///
@@ -92,10 +179,31 @@ public:
 
   void set_op(std::unique_ptr<expr> expr) override { m_op = std::move(expr); }
 
+  void accept(expr_visitor &v) const override { v.visit(*this); }
+
+  const expr *op() const { return m_op.get(); }
+
+  std::unique_ptr<expr> release_op() { return std::move(m_op); }
+
 private:
   std::unique_ptr<expr> m_op;
 };
 
+///
+/// @brief Static cost hints of a rule
+///
+/// Costs are in arbitrary units shared by the handlers of a parser, a
+/// plain string comparison typically costing 1.
+///
+struct rule_cost {
+  /// cost of an evaluation in the worst case
+  double worst{1.0};
+  /// average cost of an evaluation
+  double expected{1.0};
+  /// probability that the rule holds
+  double selectivity{0.5};
+};
+
 ///
 /// @brief Leaf expression that contains rules to enforce
 ///
@@ -106,7 +214,22 @@ public:
   rule_expr() = default;
   explicit rule_expr(interpretor &&i) : m_interpretor{std::move(i)} {}
 
-  void set_interpretor(interpretor &&i) { *m_interpretor = std::move(i); }
+  ///
+  /// @brief Contructor of a leaf built from a textual rule
+  /// @param[in] i interpretor of the rule
+  /// @param[in] rule rule text, leaves sharing the same text are
+  ///            considered as the same leaf by expression analysis
+  ///
+  rule_expr(interpretor &&i, std::string rule)
+      : m_interpretor{std::move(i)}, m_rule{std::move(rule)} {}
+
+  ///
+  /// @brief Contructor of a leaf built from a textual rule with known cost
+  ///
+  rule_expr(interpretor &&i, std::string rule, const rule_cost &cost)
+      : m_interpretor{std::move(i)}, m_rule{std::move(rule)}, m_cost{cost} {}
+
+  void set_interpretor(interpretor &&i) { m_interpretor = std::move(i); }
 
   bool interpret() const override {
     if (!m_interpretor.has_value()) {
@@ -117,7 +240,23 @@ public:
     return (*m_interpretor)();
   }
 
+  void accept(expr_visitor &v) const override { v.visit(*this); }
+
+  const std::string &rule() const { return m_rule; }
+
+  const rule_cost &cost() const { return m_cost; }
+
 private:
   std::optional<interpretor> m_interpretor;
+  std::string m_rule;
+  rule_cost m_cost;
 };
+
+///
+/// @brief Flatten associative chains into n-ary expressions
+/// @param[in] root expression to flatten
+/// @return flattened expression, the tree depth only reflecting
+///         alternations of operators
+///
+std::unique_ptr<expr> flatten(std::unique_ptr<expr> root);
 } // namespace n4
\ No newline at end of file
@@ -0,0 +1,80 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "nforce/expr.h"
+
+namespace n4 {
+///
+/// @brief Expression compiled to native code
+///
+/// The boolean skeleton is emitted as straight-line x86-64 compare and
+/// branch code into an executable mapping, AND/OR/NOT nodes becoming jumps
+/// to the next operand or to the result. Leaves are called through a
+/// direct pointer to the leaf node, there is no tree walk nor virtual
+/// dispatch on inner nodes anymore.
+///
+/// Code generation is only available on x86-64 Linux builds with the
+/// NFORCE_ENABLE_JIT option on.
+///
+class jit_expr final : public expr {
+public:
+  ///
+  /// @brief Contructor of native expression
+  /// @param[in] root expression to compile
+  /// @throw Exception on incomplete expression or when code generation is
+  ///        unavailable, root is left untouched in that case
+  ///
+  explicit jit_expr(std::unique_ptr<expr> &&root);
+  ~jit_expr();
+
+  bool interpret() const override;
+
+  void accept(expr_visitor &v) const override { m_root->accept(v); }
+
+  ///
+  /// @brief Size of the generated code in bytes
+  ///
+  std::size_t code_size() const { return m_size; }
+
+  ///
+  /// @brief True if native code can be generated in this build
+  ///
+  static bool available();
+
+private:
+  using entry = std::uint8_t (*)();
+
+  std::unique_ptr<expr> m_root;
+  void *m_code{nullptr};
+  std::size_t m_size{0};
+  std::size_t m_mapped{0};
+
+  friend class jit_compiler;
+};
+
+///
+/// @brief Compile expression to native code when available
+/// @param[in] root expression to compile
+/// @return native expression or root itself, interpreted, when code
+///         generation is unavailable
+/// @throw Exception on incomplete expression
+///
+std::unique_ptr<expr> compile_jit(std::unique_ptr<expr> root);
+} // namespace n4
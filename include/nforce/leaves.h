@@ -0,0 +1,63 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace n4 {
+class expr;
+class rule_expr;
+
+///
+/// @brief Distinct leaves of an expression
+///
+/// Leaves are indexed in left to right order of first occurrence. Rules
+/// sharing the same text are the same leaf, rules built without text are
+/// only identified by their node.
+///
+class leaf_set final {
+public:
+  ///
+  /// @brief Contructor of leaf set
+  /// @param[in] root expression to analyze
+  /// @throw Exception on incomplete expression
+  ///
+  explicit leaf_set(const expr &root);
+
+  std::size_t size() const { return m_leaves.size(); }
+
+  const rule_expr &operator[](std::size_t i) const { return *m_leaves[i]; }
+
+  ///
+  /// @brief Number of nodes of the expression sharing leaf i
+  ///
+  std::size_t occurrences(std::size_t i) const { return m_counts[i]; }
+
+  ///
+  /// @brief Index of a leaf node of the analyzed expression
+  /// @throw Exception if the node is not part of the expression
+  ///
+  std::size_t index_of(const rule_expr &leaf) const;
+
+private:
+  std::vector<const rule_expr *> m_leaves;
+  std::vector<std::size_t> m_counts;
+  std::unordered_map<std::string, std::size_t> m_by_rule;
+  std::unordered_map<const rule_expr *, std::size_t> m_by_node;
+};
+} // namespace n4
@@ -0,0 +1,97 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "nforce/expr.h"
+
+namespace n4 {
+///
+/// @brief Current value of the field a leaf reads
+///
+using field_reader = std::function<std::string_view()>;
+
+///
+/// @brief Field a leaf result only depends on, empty if the leaf cannot be
+///        memoized
+///
+using field_hint = std::function<field_reader(const rule_expr &)>;
+
+struct memo_options {
+  /// number of cached values per leaf, rounded up to a power of two
+  std::size_t capacity{256};
+};
+
+struct memo_stats {
+  std::string rule;
+  std::size_t hits{0};
+  std::size_t misses{0};
+
+  double hit_rate() const {
+    auto total = hits + misses;
+    return total ? static_cast<double>(hits) / total : 0.0;
+  }
+};
+
+///
+/// @brief Expression whose leaves remember their result per field value
+///
+/// Each memoized leaf gets a bounded direct mapped cache from the value of
+/// its field to its result, a colliding value replacing the cached one.
+/// Leaves sharing the same rule text share the same cache.
+///
+/// Caches are not synchronized: like the context its handlers read, an
+/// expression is meant to be evaluated by a single thread, concurrent
+/// evaluation using one expression per thread (see bound_expr).
+///
+class memo_expr final : public expr {
+public:
+  ///
+  /// @brief Contructor of memoized expression
+  /// @param[in] root expression to memoize
+  /// @param[in] hint field read by a leaf
+  /// @param[in] opts cache sizing
+  /// @throw Exception on incomplete expression
+  ///
+  memo_expr(std::unique_ptr<expr> root, const field_hint &hint,
+            const memo_options &opts = {});
+  ~memo_expr();
+
+  bool interpret() const override { return m_root->interpret(); }
+
+  void accept(expr_visitor &v) const override { m_root->accept(v); }
+
+  ///
+  /// @brief Cache statistics of the memoized leaves
+  ///
+  std::vector<memo_stats> stats() const;
+
+private:
+  class cache;
+
+  std::unique_ptr<expr> memoize(std::unique_ptr<expr> e,
+                                const field_hint &hint,
+                                const memo_options &opts);
+
+  std::unique_ptr<expr> m_root;
+  std::vector<std::shared_ptr<cache>> m_caches;
+};
+} // namespace n4
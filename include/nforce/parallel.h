@@ -0,0 +1,221 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "nforce/executor.h"
+#include "nforce/expr.h"
+
+namespace n4 {
+///
+/// @brief Expression bound to its own evaluation context
+///
+/// Rule handlers usually read the record to check through a reference to
+/// a context object. Evaluating records concurrently thus requires one
+/// context, and one expression built against it, per thread.
+///
+template <typename Context> class bound_expr final {
+public:
+  using builder = std::function<std::unique_ptr<expr>(Context &)>;
+
+  explicit bound_expr(const builder &b) : m_expr{b(m_ctxt)} {}
+
+  bound_expr(const bound_expr &) = delete;
+  bound_expr &operator=(const bound_expr &) = delete;
+
+  Context &context() { return m_ctxt; }
+
+  bool interpret() const { return m_expr->interpret(); }
+
+private:
+  Context m_ctxt{};
+  std::unique_ptr<expr> m_expr;
+};
+
+///
+/// @brief Tuning of parallel algorithms
+///
+struct parallel_options {
+  /// number of records per task, to be sized so that a block of
+  /// records and the evaluation state fit in cache
+  std::size_t block_size{4096};
+};
+
+namespace detail {
+// per-worker bound expressions built on first use by their worker
+template <typename Context> class worker_exprs {
+public:
+  worker_exprs(const typename bound_expr<Context>::builder &b,
+               std::size_t workers)
+      : m_builder{b}, m_exprs(workers) {}
+
+  bound_expr<Context> &get(std::size_t worker) {
+    auto &e = m_exprs[worker];
+    if (!e) {
+      e = std::make_unique<bound_expr<Context>>(m_builder);
+    }
+    return *e;
+  }
+
+private:
+  const typename bound_expr<Context>::builder &m_builder;
+  std::vector<std::unique_ptr<bound_expr<Context>>> m_exprs;
+};
+
+inline std::size_t block_count(std::size_t n, const parallel_options &opts) {
+  auto bs = std::max<std::size_t>(1, opts.block_size);
+  return (n + bs - 1) / bs;
+}
+
+// run f(block, first, last, match) over record blocks, match(i) evaluating
+// record i with the bound expression of the current worker
+template <typename Context, typename Range, typename Binder, typename Fn>
+void for_each_block(const Range &range,
+                    const typename bound_expr<Context>::builder &build,
+                    Binder &&bind, executor &ex, const parallel_options &opts,
+                    Fn &&f) {
+  auto n = static_cast<std::size_t>(std::size(range));
+  auto bs = std::max<std::size_t>(1, opts.block_size);
+  worker_exprs<Context> exprs{build, ex.size()};
+
+  ex.bulk(block_count(n, opts), [&](std::size_t b, std::size_t worker) {
+    auto &e = exprs.get(worker);
+    auto first = b * bs;
+    auto last = std::min(n, first + bs);
+    f(b, first, last, [&](std::size_t i) {
+      bind(e.context(), *(std::begin(range) + i));
+      return e.interpret();
+    });
+  });
+}
+} // namespace detail
+
+///
+/// @brief Indices of the records matching an expression, in order
+/// @param[in] range random access range of records
+/// @param[in] build builds the expression bound to a worker context
+/// @param[in] bind binds a record to a worker context, bind(ctxt, record)
+/// @param[in] ex executor evaluating record blocks
+/// @param[in] opts tuning options
+/// @throw First exception thrown by a rule or the binder
+///
+/// Each block collects its own matches, blocks being concatenated in
+/// order once evaluated so that no lock is taken on the hot path.
+///
+template <typename Context, typename Range, typename Binder>
+std::vector<std::size_t>
+parallel_filter(const Range &range,
+                const typename bound_expr<Context>::builder &build,
+                Binder &&bind, executor &ex,
+                const parallel_options &opts = {}) {
+  auto n = static_cast<std::size_t>(std::size(range));
+  std::vector<std::vector<std::size_t>> blocks(detail::block_count(n, opts));
+
+  detail::for_each_block<Context>(
+      range, build, bind, ex, opts,
+      [&](std::size_t b, std::size_t first, std::size_t last, auto &&match) {
+        auto &out = blocks[b];
+        for (auto i = first; i < last; ++i) {
+          if (match(i)) {
+            out.push_back(i);
+          }
+        }
+      });
+
+  std::size_t total = 0;
+  for (const auto &b : blocks) {
+    total += b.size();
+  }
+
+  std::vector<std::size_t> matches;
+  matches.reserve(total);
+  for (const auto &b : blocks) {
+    matches.insert(std::end(matches), std::cbegin(b), std::cend(b));
+  }
+  return matches;
+}
+
+///
+/// @brief Number of records matching an expression
+/// @see parallel_filter
+///
+template <typename Context, typename Range, typename Binder>
+std::size_t parallel_count(const Range &range,
+                           const typename bound_expr<Context>::builder &build,
+                           Binder &&bind, executor &ex,
+                           const parallel_options &opts = {}) {
+  auto n = static_cast<std::size_t>(std::size(range));
+  std::vector<std::size_t> counts(detail::block_count(n, opts));
+
+  detail::for_each_block<Context>(
+      range, build, bind, ex, opts,
+      [&](std::size_t b, std::size_t first, std::size_t last, auto &&match) {
+        std::size_t count = 0;
+        for (auto i = first; i < last; ++i) {
+          count += match(i) ? 1 : 0;
+        }
+        counts[b] = count;
+      });
+
+  std::size_t total = 0;
+  for (auto c : counts) {
+    total += c;
+  }
+  return total;
+}
+
+///
+/// @brief Index of the first record matching an expression
+/// @see parallel_filter
+///
+/// Blocks located after an already found match are skipped.
+///
+template <typename Context, typename Range, typename Binder>
+std::optional<std::size_t>
+parallel_find_first(const Range &range,
+                    const typename bound_expr<Context>::builder &build,
+                    Binder &&bind, executor &ex,
+                    const parallel_options &opts = {}) {
+  constexpr auto none = std::numeric_limits<std::size_t>::max();
+  std::atomic<std::size_t> found{none};
+
+  detail::for_each_block<Context>(
+      range, build, bind, ex, opts,
+      [&](std::size_t, std::size_t first, std::size_t last, auto &&match) {
+        for (auto i = first; i < last && i < found.load(); ++i) {
+          if (match(i)) {
+            auto curr = found.load();
+            while (i < curr && !found.compare_exchange_weak(curr, i)) {
+            }
+            return;
+          }
+        }
+      });
+
+  if (found.load() == none) {
+    return std::nullopt;
+  }
+  return found.load();
+}
+} // namespace n4
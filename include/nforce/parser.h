@@ -15,13 +15,35 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "nforce/core/status.h"
+#include "nforce/cost.h"
+#include "nforce/expr.h"
 #include "nforce/lexer.h"
 
 namespace n4 {
-class expr;
+///
+/// @brief What a parser does with an expression over its cost budget
+///
+enum class budget_action {
+  /// build() throws with status OVER_BUDGET
+  REJECT = 0,
+  /// build() returns the expression, status() being OVER_BUDGET
+  FLAG
+};
+
+struct parser_options {
+  /// no limit by default
+  cost_budget budget;
+  budget_action action{budget_action::REJECT};
+  /// compile the rules of compiling handlers on first evaluation rather
+  /// than at build time
+  bool lazy{false};
+};
 
 ///
 /// @brief Parse and evaluate expression
@@ -30,36 +52,94 @@ class parser final {
 public:
   using checker_cb = std::function<bool(const std::string &)>;
   using handler_cb = std::function<bool(const std::string &)>;
+  using compiler_cb =
+      std::function<rule_expr::interpretor(const std::string &)>;
+
+  ///
+  /// @brief Rule checker and handler, with the cost of the rules handled
+  ///
+  /// A compiling handler prepares a rule once, regex compilation for
+  /// instance, into the interpretor evaluating it. The checker should
+  /// then only decide cheaply whether the handler owns the rule.
+  ///
+  struct rule_handler : std::pair<checker_cb, handler_cb> {
+    rule_handler() = default;
 
-  using rule_handler = std::pair<checker_cb, handler_cb>;
+    rule_handler(checker_cb checker, handler_cb handler,
+                 const rule_cost &c = {})
+        : std::pair<checker_cb, handler_cb>{std::move(checker),
+                                            std::move(handler)},
+          cost{c} {}
+
+    rule_handler(checker_cb checker, compiler_cb compiler,
+                 const rule_cost &c = {})
+        : rule_handler{std::move(checker),
+                       [compiler](const std::string &str) {
+                         return compiler(str)();
+                       },
+                       c} {
+      compile = std::move(compiler);
+    }
+
+    template <typename Checker, typename Handler>
+    rule_handler(std::pair<Checker, Handler> p, const rule_cost &c = {})
+        : rule_handler{std::move(p.first), std::move(p.second), c} {}
+
+    rule_cost cost;
+    /// empty for handlers evaluating the rule text on each evaluation
+    compiler_cb compile;
+  };
 
   ///
   /// @brief Contructor of parser
   /// @param[in] lexer
+  /// @param[in] handlerList handlers of the rules, tried in order
+  /// @param[in] opts cost budget of built expressions and build mode
   ///
-  explicit parser(lexer &lexer, std::vector<rule_handler> &&handlerList);
+  parser(lexer &lexer, std::vector<rule_handler> &&handlerList,
+         const parser_options &opts = {});
 
   ///
   /// @brief Evaluate expression
   /// @return expression to evaluate
+  /// @throw Exception on invalid expression, or with status OVER_BUDGET if
+  ///        the expression exceeds a budget to enforce
   ///
   /// @warning The handlers must stay valid for the expression to be valid
   ///
   std::unique_ptr<expr> build();
 
+  ///
+  /// @brief Status of the last built expression, OVER_BUDGET if it was
+  ///        flagged as exceeding its budget
+  ///
+  status_type status() const { return m_status; }
+
+  ///
+  /// @brief Interpretor of a rule owned by a handler, as built by build()
+  /// @param[in] handler handler owning the rule
+  /// @param[in] rule rule text
+  /// @param[in] lazy defer the compilation of the rule to its first
+  ///            evaluation
+  ///
+  static rule_expr::interpretor interpretor_of(const rule_handler &handler,
+                                               const std::string &rule,
+                                               bool lazy);
+
 private:
   /// Unit functions for recursive descent parsing
   void expression();
-  void eprime();
+  bool eprime();
   void term();
   void tprime();
   void factor();
-  void binary(std::unique_ptr<binary_expr>);
   void unary(std::unique_ptr<unary_expr>);
   void rule();
 
   std::vector<rule_handler> m_handlers;
   lexer &m_lex;
+  parser_options m_opts;
+  status_type m_status{status_type::SUCCESS};
   std::unique_ptr<expr> m_root;
   token m_curr{token_type::END, std::nullopt};
 };
@@ -0,0 +1,103 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace n4 {
+class expr;
+class rule_expr;
+
+///
+/// @brief Literals that must all appear in a record for a leaf to hold
+///
+/// An empty list means the leaf implies nothing about the record.
+///
+using literal_hint = std::function<std::vector<std::string>(const rule_expr &)>;
+
+struct prefilter_options {
+  /// maximum number of clauses kept, extra clauses are dropped
+  std::size_t max_clauses = 16;
+  /// maximum number of alternative literals in a clause
+  std::size_t max_width = 8;
+};
+
+///
+/// @brief Cheap record check rejecting records an expression cannot match
+///
+/// The literals required by the leaves are propagated through the
+/// expression as a conjunction of clauses, a record being able to match
+/// only if it contains at least one literal of every clause. Dropping a
+/// clause only weakens the filter so the analysis stays bounded.
+///
+/// Records are first checked against a bigram signature of the literals
+/// and a literal is only searched for when the signature allows it.
+///
+class prefilter final {
+public:
+  using clause = std::vector<std::string>;
+
+  ///
+  /// @brief Contructor of prefilter
+  /// @param[in] root expression to analyze
+  /// @param[in] hint required literals of a leaf
+  /// @param[in] opts analysis bounds
+  /// @throw Exception on incomplete expression
+  ///
+  prefilter(const expr &root, const literal_hint &hint,
+            const prefilter_options &opts = {});
+
+  ///
+  /// @brief Check a record
+  /// @return false if the expression cannot hold for the record
+  ///
+  bool may_match(std::string_view record) const;
+
+  ///
+  /// @brief True if the filter never rejects
+  ///
+  bool empty() const { return m_clauses.empty(); }
+
+  const std::vector<clause> &clauses() const { return m_clauses; }
+
+private:
+  using signature = std::array<std::uint64_t, 4>;
+
+  struct needle {
+    std::string_view text;
+    signature sig;
+  };
+
+  static signature sign(std::string_view str);
+
+  std::vector<clause> m_clauses;
+  std::vector<std::vector<needle>> m_needles;
+};
+
+///
+/// @brief Literals a regular expression match requires
+///
+/// Conservative extraction of the plain character runs of an ECMAScript
+/// pattern, nothing being returned for patterns with top level
+/// alternatives.
+///
+std::vector<std::string> regex_literals(const std::string &pattern);
+} // namespace n4
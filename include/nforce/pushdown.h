@@ -0,0 +1,97 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace n4 {
+class expr;
+class rule_expr;
+
+///
+/// @brief Sorted identifiers of records
+///
+using record_set = std::vector<std::size_t>;
+
+///
+/// @brief How a source evaluates a leaf natively
+///
+enum class pushdown_type {
+  /// the leaf is evaluated record by record by its handler
+  NONE = 0,
+  /// the leaf holds for exactly the returned records
+  EXACT,
+  /// the leaf can only hold for the returned records, its handler still
+  /// deciding for them
+  RESTRICT
+};
+
+struct pushed_leaf {
+  pushdown_type type{pushdown_type::NONE};
+  record_set records;
+};
+
+///
+/// @brief Source of records able to evaluate some leaves by itself
+///
+/// A sorted index, a dictionary encoded column or a file parser able to
+/// skip whole sections answers for a leaf with a set of records instead of
+/// having every record materialized and checked by the leaf handler.
+///
+class record_source {
+public:
+  virtual ~record_source() = default;
+
+  ///
+  /// @brief Number of records, identified from 0 to size() - 1
+  ///
+  virtual std::size_t size() const = 0;
+
+  ///
+  /// @brief Native evaluation of a leaf, called once per distinct leaf
+  ///
+  virtual pushed_leaf push(const rule_expr &leaf) = 0;
+
+  ///
+  /// @brief Materialize a record for the handlers of the residual leaves
+  ///
+  virtual void load(std::size_t record) = 0;
+};
+
+struct pushdown_result {
+  /// matching records
+  record_set matches;
+  /// number of leaves evaluated by the source
+  std::size_t pushed{0};
+  /// number of records loaded to evaluate the residual expression
+  std::size_t loaded{0};
+};
+
+///
+/// @brief Records of a source matching an expression
+///
+/// Pushed leaves bound the records that may match and those that surely
+/// match. Only the records in between are loaded and checked against the
+/// residual expression, pushed leaves being answered by set membership
+/// there.
+///
+/// @param[in] root expression to evaluate
+/// @param[in] source records and native leaf evaluation
+/// @throw Exception on incomplete expression or a pushed record out of
+///        the source range
+///
+pushdown_result pushdown_filter(const expr &root, record_source &source);
+} // namespace n4
@@ -0,0 +1,214 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "nforce/parser.h"
+
+namespace n4 {
+class expr;
+
+///
+/// @brief Named expressions reloaded without blocking evaluating threads
+///
+/// Each reload publishes a new immutable version through an atomic
+/// pointer swap. Readers pin the current version for the duration of a
+/// read guard without taking any lock and old versions are reclaimed once
+/// no reader can still hold them (epoch based reclamation).
+///
+/// A reload only rebuilds the rules whose text changed, unchanged rules
+/// and the storage shards holding no changed rule being shared with the
+/// previous version. Leaves are also cached by rule text, with their owning
+/// handler and built interpretor, so that a rebuilt rule neither runs the
+/// handler checkers nor compiles again the leaves it shares with live rules.
+/// A leaf leaves the cache once no live version references it anymore.
+///
+/// @warning Handlers must support concurrent interpretation since
+///          several readers may evaluate the same expression
+///
+class ruleset final {
+public:
+  struct rule {
+    std::string text;
+    std::unique_ptr<expr> expression;
+  };
+
+  using change = std::pair<std::string, std::optional<std::string>>;
+
+  static constexpr std::size_t shard_count = 64;
+
+  ///
+  /// @brief Immutable set of rules
+  ///
+  class version final {
+  public:
+    std::uint64_t id() const { return m_id; }
+    std::size_t size() const { return m_size; }
+
+    ///
+    /// @brief Rule by name, nullptr if missing
+    ///
+    const rule *find(const std::string &name) const;
+
+  private:
+    using shard = std::unordered_map<std::string, std::shared_ptr<const rule>>;
+
+    std::uint64_t m_id{0};
+    std::size_t m_size{0};
+    std::vector<std::shared_ptr<const shard>> m_shards;
+
+    friend class ruleset;
+  };
+
+  class reader;
+
+  ///
+  /// @brief Pinned version, to be released quickly
+  ///
+  class read_guard final {
+  public:
+    read_guard(read_guard &&other) noexcept;
+    read_guard(const read_guard &) = delete;
+    read_guard &operator=(const read_guard &) = delete;
+    read_guard &operator=(read_guard &&) = delete;
+    ~read_guard();
+
+    const version &operator*() const { return *m_version; }
+    const version *operator->() const { return m_version; }
+
+  private:
+    read_guard(const version *v, std::atomic<std::uint64_t> *epoch)
+        : m_version{v}, m_epoch{epoch} {}
+
+    const version *m_version;
+    std::atomic<std::uint64_t> *m_epoch;
+
+    friend class reader;
+  };
+
+  ///
+  /// @brief Per-thread read handle
+  ///
+  /// Registration takes a lock, reads do not. A reader must hold at most
+  /// one read guard at a time.
+  ///
+  class reader final {
+  public:
+    explicit reader(ruleset &rs);
+    ~reader();
+
+    reader(const reader &) = delete;
+    reader &operator=(const reader &) = delete;
+
+    read_guard read();
+
+  private:
+    ruleset &m_rs;
+    std::size_t m_slot;
+    std::atomic<std::uint64_t> *m_epoch;
+  };
+
+  ///
+  /// @brief Contructor of ruleset
+  /// @param[in] handlerList handlers used to build every rule
+  /// @param[in] opts options of the parser building every rule, lazy
+  ///            building deferring the compilation of a rule to its first
+  ///            evaluation
+  ///
+  explicit ruleset(std::vector<parser::rule_handler> &&handlerList,
+                   const parser_options &opts = {});
+  ~ruleset();
+
+  ruleset(const ruleset &) = delete;
+  ruleset &operator=(const ruleset &) = delete;
+
+  ///
+  /// @brief Replace all rules
+  /// @param[in] rules rule texts by name
+  /// @return number of rebuilt rules
+  /// @throw Exception if a changed rule does not build, nothing being
+  ///        published in that case
+  ///
+  std::size_t reload(const std::unordered_map<std::string, std::string> &rules);
+
+  ///
+  /// @brief Apply a list of changes, cost only depends on the changes
+  /// @param[in] changes rule text by name, nullopt to remove the rule
+  /// @return number of rebuilt rules
+  /// @throw Exception if a changed rule does not build, nothing being
+  ///        published in that case
+  ///
+  std::size_t update(const std::vector<change> &changes);
+
+  ///
+  /// @brief Free retired versions no reader can hold anymore
+  /// @return number of versions still waiting for readers
+  ///
+  std::size_t reclaim();
+
+  ///
+  /// @brief Number of distinct leaves cached for live versions
+  ///
+  std::size_t cached_leaves();
+
+private:
+  struct alignas(64) slot {
+    std::atomic<std::uint64_t> epoch{idle};
+    bool used{false};
+  };
+
+  static constexpr std::uint64_t idle =
+      std::numeric_limits<std::uint64_t>::max();
+
+  static std::size_t shard_of(const std::string &name);
+
+  // owner of a rule text and interpretor shared by the leaves built from it
+  struct cached_leaf {
+    std::size_t owner;
+    std::weak_ptr<const rule_expr::interpretor> interpretor;
+  };
+
+  std::unique_ptr<expr> build(const std::string &text);
+  rule_expr::interpretor leaf(std::size_t owner, const std::string &text);
+  std::size_t update_locked(const std::vector<change> &changes);
+  void publish(std::unique_ptr<version> next);
+  std::size_t collect();
+
+  std::vector<parser::rule_handler> m_handlers;
+  parser_options m_opts;
+  std::unordered_map<std::string, cached_leaf> m_leaves;
+
+  std::atomic<const version *> m_current{nullptr};
+  std::atomic<std::uint64_t> m_epoch{0};
+
+  std::mutex m_writer;
+  std::vector<std::pair<std::uint64_t, std::unique_ptr<const version>>>
+      m_retired;
+
+  std::mutex m_slots_mutex;
+  std::vector<std::unique_ptr<slot>> m_slots;
+};
+} // namespace n4
@@ -0,0 +1,108 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace n4 {
+class expr;
+class rule_expr;
+
+///
+/// @brief Value of a leaf known in the current scope, nullopt if it varies
+///
+using leaf_oracle = std::function<std::optional<bool>(const rule_expr &)>;
+
+///
+/// @brief Residual of an expression for the leaves decided in a scope
+/// @param[in] root expression to specialize
+/// @param[in] oracle value of the decided leaves
+/// @return expression where decided leaves are folded away and dead
+///         branches removed, a fully decided expression being a single
+///         leaf without rule text returning the constant
+/// @throw Exception on incomplete expression
+///
+/// @warning Remaining leaves call the leaves of the source expression which
+///          must outlive the residual
+///
+std::unique_ptr<expr> specialize(const expr &root, const leaf_oracle &oracle);
+
+///
+/// @brief Leaf values by rule text
+///
+std::unique_ptr<expr>
+specialize(const expr &root,
+           const std::unordered_map<std::string, bool> &known);
+
+///
+/// @brief Residual expressions cached by scope key
+///
+/// The oracle is only consulted the first time a scope is seen, records of
+/// the scope then only evaluate the leaves that vary. The cache is cleared
+/// when full.
+///
+template <typename Key, typename Hash = std::hash<Key>>
+class specializer final {
+public:
+  ///
+  /// @brief Contructor of specializer
+  /// @param[in] root source expression, to outlive the specializer
+  /// @param[in] capacity maximum number of cached scopes
+  ///
+  explicit specializer(const expr &root, std::size_t capacity = 1024)
+      : m_root{root}, m_capacity{capacity} {}
+
+  ///
+  /// @brief Residual of a scope
+  /// @param[in] key scope key
+  /// @param[in] oracle leaf values of the scope, used on cache miss only
+  ///
+  std::shared_ptr<const expr> get(const Key &key, const leaf_oracle &oracle) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (auto hit = m_cache.find(key); hit != m_cache.end()) {
+      return hit->second;
+    }
+
+    if (m_cache.size() >= m_capacity) {
+      m_cache.clear();
+    }
+    std::shared_ptr<const expr> residual = specialize(m_root, oracle);
+    m_cache.emplace(key, residual);
+    return residual;
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_cache.size();
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_cache.clear();
+  }
+
+private:
+  const expr &m_root;
+  std::size_t m_capacity;
+  mutable std::mutex m_mutex;
+  std::unordered_map<Key, std::shared_ptr<const expr>, Hash> m_cache;
+};
+} // namespace n4
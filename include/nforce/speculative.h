@@ -0,0 +1,80 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+#include "nforce/executor.h"
+#include "nforce/expr.h"
+
+namespace n4 {
+///
+/// @brief True for leaves worth evaluating concurrently
+///
+using expensive_hint = std::function<bool(const rule_expr &)>;
+
+///
+/// @brief Expression evaluating its expensive operands concurrently
+///
+/// AND/OR nodes with at least two operands holding an expensive leaf
+/// evaluate them at the same time, the calling thread running operands
+/// itself while pool workers pick the others. The first operand deciding
+/// the result cancels the others: operands not started yet are skipped
+/// and running ones are asked to stop through cancellation_requested().
+/// Interpretation returns once no operand is running anymore, so that no
+/// handler outlives the evaluation of the record.
+///
+/// When the pool is saturated, nodes are evaluated sequentially by the
+/// calling thread.
+///
+/// An operand exception is only reported if no other operand decides the
+/// result.
+///
+class speculative_expr final : public expr {
+public:
+  ///
+  /// @brief Contructor of speculative expression
+  /// @param[in] root expression to evaluate
+  /// @param[in] pool executor running operands, to outlive the expression
+  /// @param[in] hint expensive leaves
+  /// @throw Exception on incomplete expression
+  ///
+  speculative_expr(std::unique_ptr<expr> root, executor &pool,
+                   const expensive_hint &hint);
+
+  bool interpret() const override { return m_root->interpret(); }
+
+  void accept(expr_visitor &v) const override { m_root->accept(v); }
+
+  ///
+  /// @brief Number of nodes evaluating operands concurrently
+  ///
+  std::size_t parallel_nodes() const { return m_parallel; }
+
+private:
+  std::unique_ptr<expr> m_root;
+  std::size_t m_parallel{0};
+
+  friend class speculative_builder;
+};
+
+///
+/// @brief True if the operand being evaluated by this thread is not needed
+///        anymore, to be polled by long running handlers
+///
+bool cancellation_requested();
+} // namespace n4
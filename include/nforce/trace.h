@@ -0,0 +1,141 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+namespace n4 {
+///
+/// @brief Phase of the life of an expression
+///
+enum class trace_phase : std::uint8_t {
+  /// lexer::next
+  LEX = 0,
+  /// scan of the rule checkers for the handler owning a rule
+  MATCH,
+  /// whole parser::build, enclosing the lex and match spans
+  BUILD,
+  /// evaluation of a leaf by its handler
+  INTERPRET
+};
+
+///
+/// @brief Timestamped span of a phase
+///
+struct trace_event {
+  static constexpr std::uint32_t no_handler =
+      std::numeric_limits<std::uint32_t>::max();
+
+  trace_phase phase{trace_phase::LEX};
+  /// identifier of the built expression, 0 outside of any build
+  std::uint64_t expr_id{0};
+  /// index of the rule handler involved, no_handler if none
+  std::uint32_t handler{no_handler};
+  /// recording thread, numbered in order of first record
+  std::uint32_t thread{0};
+  /// steady clock nanoseconds
+  std::uint64_t begin{0};
+  std::uint64_t end{0};
+};
+
+///
+/// @brief Check if tracing was compiled in (NFORCE_ENABLE_TRACE)
+///
+bool tracing_available();
+
+///
+/// @brief Start or stop recording spans, no-op if tracing is unavailable
+///
+void enable_tracing(bool on);
+
+bool tracing_enabled();
+
+///
+/// @brief Remove and return the recorded spans, grouped by thread
+///
+/// Each thread records to its own lock-free ring buffer, spans recorded
+/// while the buffer of a thread is full being dropped.
+///
+std::vector<trace_event> drain_traces();
+
+///
+/// @brief Number of spans dropped on full buffers so far
+///
+std::uint64_t dropped_traces();
+
+///
+/// @brief Write spans as a Chrome trace (chrome://tracing, Perfetto)
+///
+void write_chrome_trace(std::ostream &os,
+                        const std::vector<trace_event> &events);
+
+///
+/// @brief Span recorded from construction to destruction if tracing is
+///        enabled, tagged with the current expression by default
+///
+class trace_span final {
+public:
+  explicit trace_span(trace_phase phase,
+                      std::uint32_t handler = trace_event::no_handler);
+  trace_span(trace_phase phase, std::uint32_t handler, std::uint64_t expr_id);
+  ~trace_span();
+
+  trace_span(const trace_span &) = delete;
+  trace_span &operator=(const trace_span &) = delete;
+
+  void set_handler(std::uint32_t handler) { m_event.handler = handler; }
+
+private:
+  trace_event m_event;
+  bool m_active;
+};
+
+///
+/// @brief Expression the spans of the current thread are tagged with
+///
+class trace_expr_scope final {
+public:
+  trace_expr_scope();
+  ~trace_expr_scope();
+
+  trace_expr_scope(const trace_expr_scope &) = delete;
+  trace_expr_scope &operator=(const trace_expr_scope &) = delete;
+
+  std::uint64_t id() const { return m_id; }
+
+private:
+  std::uint64_t m_id;
+  std::uint64_t m_prev;
+};
+
+///
+/// @brief Identifier of the expression of the current thread, 0 if none
+///
+std::uint64_t current_trace_expr();
+} // namespace n4
+
+// Instrumentation, compiled out unless NFORCE_TRACE is defined
+#ifdef NFORCE_TRACE
+#define NFORCE_TRACE_SPAN(name, ...) ::n4::trace_span name{__VA_ARGS__}
+#define NFORCE_TRACE_HANDLER(name, h) (name).set_handler(h)
+#define NFORCE_TRACE_EXPR(name) ::n4::trace_expr_scope name
+#else
+#define NFORCE_TRACE_SPAN(name, ...)
+#define NFORCE_TRACE_HANDLER(name, h)
+#define NFORCE_TRACE_EXPR(name)
+#endif
@@ -0,0 +1,75 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "nforce/expr.h"
+#include "nforce/leaves.h"
+
+namespace n4 {
+///
+/// @brief Expression compiled into the truth table of its boolean skeleton
+///
+/// Interpretation evaluates every distinct leaf once, packs the results
+/// into an index (leaf i being bit i) and returns the matching bit of the
+/// table. There is no branching on the expression structure anymore but
+/// leaves are not short-circuited either.
+///
+class truth_table_expr final : public expr {
+public:
+  static constexpr std::size_t max_leaves = 16;
+
+  ///
+  /// @brief Contructor of truth table
+  /// @param[in] root expression to compile
+  /// @throw Exception on incomplete expression or more than
+  ///        max_leaves distinct leaves
+  ///
+  explicit truth_table_expr(std::unique_ptr<expr> root);
+
+  bool interpret() const override;
+
+  void accept(expr_visitor &v) const override { m_root->accept(v); }
+
+  ///
+  /// @brief Expression result for already evaluated leaves
+  /// @param[in] index leaf results, leaf i being bit i
+  ///
+  bool lookup(std::uint32_t index) const {
+    return (m_table[index >> 6] >> (index & 63)) & 1u;
+  }
+
+  const leaf_set &leaves() const { return m_leaves; }
+
+private:
+  std::unique_ptr<expr> m_root;
+  leaf_set m_leaves;
+  std::vector<std::uint64_t> m_table;
+};
+
+///
+/// @brief Compile expression into a truth table when it has few leaves
+/// @param[in] root expression to compile
+/// @param[in] max_leaves maximum number of distinct leaves to compile
+/// @return truth table expression or root itself if it has too many leaves
+///
+std::unique_ptr<expr>
+compile_truth_table(std::unique_ptr<expr> root,
+                    std::size_t max_leaves = truth_table_expr::max_leaves);
+} // namespace n4
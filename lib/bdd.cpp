@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+#include "nforce/bdd.h"
+#include "nforce/core/except.h"
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+constexpr std::uint32_t false_node = 0;
+constexpr std::uint32_t true_node = 1;
+constexpr std::uint32_t terminal_level =
+    std::numeric_limits<std::uint32_t>::max();
+
+using node_key = std::tuple<std::uint32_t, std::uint32_t, std::uint32_t>;
+
+struct node_key_hash {
+  std::size_t operator()(const node_key &k) const {
+    auto h = std::hash<std::uint64_t>{}(
+        (std::uint64_t{std::get<0>(k)} << 32) | std::get<1>(k));
+    return h ^ (std::hash<std::uint32_t>{}(std::get<2>(k)) + 0x9e3779b9 +
+                (h << 6) + (h >> 2));
+  }
+};
+
+const expr &checked(const std::unique_ptr<expr> &root) {
+  if (!root) {
+    throw nexcept("[nforce] missing expression", status_type::BAD_AST);
+  }
+  return *root;
+}
+} // namespace
+
+class bdd_builder final : public expr_visitor {
+public:
+  bdd_builder(bdd_expr &bdd, std::size_t max_nodes,
+              std::vector<std::uint32_t> &&level_of)
+      : m_bdd{bdd}, m_max_nodes{max_nodes + 2},
+        m_level_of{std::move(level_of)} {
+    m_bdd.m_nodes = {{terminal_level, false_node, false_node},
+                     {terminal_level, true_node, true_node}};
+  }
+
+  std::uint32_t build(const expr &e) {
+    e.accept(*this);
+    return m_res;
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::OR> &e) override {
+    auto [op1, op2] = this->operands(e.left_op(), e.right_op());
+    m_res = this->apply(binary_op_type::OR, op1, op2);
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::AND> &e) override {
+    auto [op1, op2] = this->operands(e.left_op(), e.right_op());
+    m_res = this->apply(binary_op_type::AND, op1, op2);
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::OR> &e) override {
+    m_res = this->nary(binary_op_type::OR, e);
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::AND> &e) override {
+    m_res = this->nary(binary_op_type::AND, e);
+  }
+
+  void visit(const unary_not_expr &e) override {
+    if (!e.op()) {
+      throw nexcept("[nforce] missing unary operand", status_type::BAD_AST);
+    }
+    m_res = this->negate(this->build(*e.op()));
+  }
+
+  void visit(const rule_expr &e) override {
+    m_res = this->make(m_level_of[m_bdd.m_leaves.index_of(e)], false_node,
+                       true_node);
+  }
+
+private:
+  std::pair<std::uint32_t, std::uint32_t> operands(const expr *op1,
+                                                   const expr *op2) {
+    if (!op1 || !op2) {
+      throw nexcept("[nforce] missing binary operand", status_type::BAD_AST);
+    }
+    auto res1 = this->build(*op1);
+    return {res1, this->build(*op2)};
+  }
+
+  template <binary_op_type Op>
+  std::uint32_t nary(binary_op_type op, const nary_gen_expr<Op> &e) {
+    if (e.size() == 0) {
+      throw nexcept("[nforce] missing n-ary operand", status_type::BAD_AST);
+    }
+
+    auto res = (op == binary_op_type::AND) ? true_node : false_node;
+    for (std::size_t i = 0; i < e.size(); ++i) {
+      if (!e.op(i)) {
+        throw nexcept("[nforce] missing n-ary operand", status_type::BAD_AST);
+      }
+      res = this->apply(op, res, this->build(*e.op(i)));
+    }
+    return res;
+  }
+
+  std::uint32_t level(std::uint32_t n) const { return m_bdd.m_nodes[n].level; }
+
+  std::uint32_t make(std::uint32_t level, std::uint32_t low,
+                     std::uint32_t high) {
+    if (low == high) {
+      return low;
+    }
+
+    auto key = node_key{level, low, high};
+    auto hit = m_unique.find(key);
+    if (hit != std::cend(m_unique)) {
+      return hit->second;
+    }
+
+    if (m_bdd.m_nodes.size() >= m_max_nodes) {
+      throw nexcept("[nforce] decision diagram too large",
+                    status_type::INTERNAL_ERROR);
+    }
+
+    auto n = static_cast<std::uint32_t>(m_bdd.m_nodes.size());
+    m_bdd.m_nodes.push_back({level, low, high});
+    m_unique.emplace(key, n);
+    return n;
+  }
+
+  std::uint32_t apply(binary_op_type op, std::uint32_t n1, std::uint32_t n2) {
+    // terminal cases
+    auto absorbing = (op == binary_op_type::AND) ? false_node : true_node;
+    auto neutral = (op == binary_op_type::AND) ? true_node : false_node;
+    if (n1 == absorbing || n2 == absorbing) {
+      return absorbing;
+    }
+    if (n1 == neutral || n1 == n2) {
+      return n2;
+    }
+    if (n2 == neutral) {
+      return n1;
+    }
+
+    // commutative operators
+    if (n1 > n2) {
+      std::swap(n1, n2);
+    }
+
+    auto key = node_key{static_cast<std::uint32_t>(op), n1, n2};
+    auto hit = m_computed.find(key);
+    if (hit != std::cend(m_computed)) {
+      return hit->second;
+    }
+
+    auto l = std::min(this->level(n1), this->level(n2));
+    auto [low1, high1] = this->cofactors(n1, l);
+    auto [low2, high2] = this->cofactors(n2, l);
+    auto low = this->apply(op, low1, low2);
+    auto res = this->make(l, low, this->apply(op, high1, high2));
+
+    m_computed.emplace(key, res);
+    return res;
+  }
+
+  std::uint32_t negate(std::uint32_t n) {
+    if (n <= true_node) {
+      return n ^ 1u;
+    }
+
+    auto hit = m_negated.find(n);
+    if (hit != std::cend(m_negated)) {
+      return hit->second;
+    }
+
+    auto node = m_bdd.m_nodes[n];
+    auto low = this->negate(node.low);
+    auto res = this->make(node.level, low, this->negate(node.high));
+
+    m_negated.emplace(n, res);
+    return res;
+  }
+
+  std::pair<std::uint32_t, std::uint32_t> cofactors(std::uint32_t n,
+                                                    std::uint32_t l) const {
+    const auto &node = m_bdd.m_nodes[n];
+    if (node.level != l) {
+      return {n, n};
+    }
+    return {node.low, node.high};
+  }
+
+  bdd_expr &m_bdd;
+  std::size_t m_max_nodes;
+  std::vector<std::uint32_t> m_level_of;
+  std::unordered_map<node_key, std::uint32_t, node_key_hash> m_unique;
+  std::unordered_map<node_key, std::uint32_t, node_key_hash> m_computed;
+  std::unordered_map<std::uint32_t, std::uint32_t> m_negated;
+  std::uint32_t m_res{false_node};
+};
+
+//-------------------------------------
+// Public
+
+bdd_expr::bdd_expr(std::unique_ptr<expr> &&root, std::size_t max_nodes,
+                   const cost_hint &cost)
+    : m_leaves{checked(root)} {
+  // leaf order
+  std::vector<double> costs(m_leaves.size(), 1.0);
+  if (cost) {
+    for (std::size_t i = 0; i < costs.size(); ++i) {
+      costs[i] = cost(m_leaves[i]);
+    }
+  }
+
+  m_order.resize(m_leaves.size());
+  std::iota(std::begin(m_order), std::end(m_order), 0);
+  std::stable_sort(std::begin(m_order), std::end(m_order),
+                   [&](auto i1, auto i2) {
+                     if (costs[i1] != costs[i2]) {
+                       return costs[i1] < costs[i2];
+                     }
+                     return m_leaves.occurrences(i1) >
+                            m_leaves.occurrences(i2);
+                   });
+
+  std::vector<std::uint32_t> level_of(m_leaves.size());
+  for (std::size_t l = 0; l < m_order.size(); ++l) {
+    level_of[m_order[l]] = static_cast<std::uint32_t>(l);
+    m_levels.push_back(&m_leaves[m_order[l]]);
+  }
+
+  // build and keep only nodes reachable from the start node
+  bdd_builder builder{*this, max_nodes, std::move(level_of)};
+  auto start = builder.build(*root);
+
+  std::vector<std::uint32_t> renum(m_nodes.size(), terminal_level);
+  std::vector<node> nodes{m_nodes[false_node], m_nodes[true_node]};
+  renum[false_node] = false_node;
+  renum[true_node] = true_node;
+
+  std::vector<std::uint32_t> stack{start};
+  while (!stack.empty()) {
+    auto n = stack.back();
+    if (renum[n] != terminal_level) {
+      stack.pop_back();
+      continue;
+    }
+
+    const auto &old = m_nodes[n];
+    if (renum[old.low] == terminal_level) {
+      stack.push_back(old.low);
+    } else if (renum[old.high] == terminal_level) {
+      stack.push_back(old.high);
+    } else {
+      renum[n] = static_cast<std::uint32_t>(nodes.size());
+      nodes.push_back({old.level, renum[old.low], renum[old.high]});
+      stack.pop_back();
+    }
+  }
+
+  m_nodes = std::move(nodes);
+  m_start = renum[start];
+  m_root = std::move(root);
+}
+
+bool bdd_expr::interpret() const {
+  auto n = m_start;
+  while (n > true_node) {
+    const auto &node = m_nodes[n];
+    n = m_levels[node.level]->interpret() ? node.high : node.low;
+  }
+  return n == true_node;
+}
+
+std::unique_ptr<expr> compile_bdd(std::unique_ptr<expr> root,
+                                  std::size_t max_nodes,
+                                  const bdd_expr::cost_hint &cost) {
+  // report incomplete expressions, only fall back on size
+  leaf_set{checked(root)};
+
+  try {
+    return std::make_unique<bdd_expr>(std::move(root), max_nodes, cost);
+  } catch (const nexcept &e) {
+    if (e.status() != status_type::INTERNAL_ERROR) {
+      throw;
+    }
+    return root;
+  }
+}
+} // namespace n4
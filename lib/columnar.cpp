@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <bitset>
+#include <charconv>
+#include <cstring>
+
+#include "nforce/columnar.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NFORCE_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+struct columnar_scan::instr {
+  enum class kind { LEAF = 0, NOT, AND, OR };
+
+  kind type;
+  std::size_t arg;
+};
+
+// postfix program of the boolean structure
+class columnar_compiler final : public expr_visitor {
+  using instr = columnar_scan::instr;
+
+public:
+  columnar_compiler(const leaf_set &leaves, std::vector<instr> &program)
+      : m_leaves{leaves}, m_program{program} {}
+
+  void visit(const binary_gen_expr<binary_op_type::OR> &e) override {
+    this->binary(e.left_op(), e.right_op(), instr::kind::OR);
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::AND> &e) override {
+    this->binary(e.left_op(), e.right_op(), instr::kind::AND);
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::OR> &e) override {
+    this->nary(e, instr::kind::OR);
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::AND> &e) override {
+    this->nary(e, instr::kind::AND);
+  }
+
+  void visit(const unary_not_expr &e) override {
+    e.op()->accept(*this);
+    m_program.push_back({instr::kind::NOT, 1});
+  }
+
+  void visit(const rule_expr &e) override {
+    m_program.push_back({instr::kind::LEAF, m_leaves.index_of(e)});
+    m_depth = std::max(m_depth, ++m_curr);
+  }
+
+  std::size_t depth() const { return m_depth; }
+
+private:
+  void binary(const expr *op1, const expr *op2, instr::kind type) {
+    op1->accept(*this);
+    op2->accept(*this);
+    m_program.push_back({type, 2});
+    --m_curr;
+  }
+
+  template <binary_op_type Op>
+  void nary(const nary_gen_expr<Op> &e, instr::kind type) {
+    for (std::size_t i = 0; i < e.size(); ++i) {
+      e.op(i)->accept(*this);
+    }
+    m_program.push_back({type, e.size()});
+    m_curr -= e.size() - 1;
+  }
+
+  const leaf_set &m_leaves;
+  std::vector<instr> &m_program;
+  std::size_t m_curr{0};
+  std::size_t m_depth{0};
+};
+
+namespace {
+const char *op_chars = "=!<>^*";
+
+bool is_string_op(column_op_type op) {
+  return op == column_op_type::EQ || op == column_op_type::NE ||
+         op == column_op_type::PREFIX || op == column_op_type::CONTAINS;
+}
+
+std::string_view str_value(const column_set::column &col, std::size_t row) {
+  return {col.bytes + col.offsets[row],
+          col.offsets[row + 1] - col.offsets[row]};
+}
+
+template <typename T> bool compare(column_op_type op, T v, T c) {
+  switch (op) {
+  case column_op_type::EQ:
+    return v == c;
+  case column_op_type::NE:
+    return v != c;
+  case column_op_type::LT:
+    return v < c;
+  case column_op_type::LE:
+    return v <= c;
+  case column_op_type::GT:
+    return v > c;
+  case column_op_type::GE:
+    return v >= c;
+  default:
+    return false;
+  }
+}
+
+bool eval_row(const column_set::rule &r, std::size_t row) {
+  if (r.col->values) {
+    return compare(r.op, r.col->values[row], r.value);
+  }
+
+  auto v = str_value(*r.col, row);
+  switch (r.op) {
+  case column_op_type::PREFIX:
+    return v.substr(0, r.text.size()) == r.text;
+  case column_op_type::CONTAINS:
+    return v.find(r.text) != std::string_view::npos;
+  default:
+    return compare<std::string_view>(r.op, v, r.text);
+  }
+}
+
+// bits of rows [0, n) for pred(i)
+template <typename Pred>
+void scalar_kernel(std::size_t n, std::uint64_t *out, Pred &&pred) {
+  for (std::size_t w = 0; w * 64 < n; ++w) {
+    auto len = std::min<std::size_t>(64, n - w * 64);
+    std::uint64_t bits = 0;
+    for (std::size_t j = 0; j < len; ++j) {
+      bits |= static_cast<std::uint64_t>(pred(w * 64 + j)) << j;
+    }
+    out[w] = bits;
+  }
+}
+
+template <column_op_type Op>
+void int_kernel(const std::int64_t *v, std::int64_t c, std::size_t n,
+                std::uint64_t *out) {
+  scalar_kernel(n, out, [=](std::size_t i) { return compare(Op, v[i], c); });
+}
+
+#if defined(NFORCE_HAS_AVX2)
+// eq and gt comparisons, other operators being their negation
+template <column_op_type Op>
+__attribute__((target("avx2"))) void
+int_kernel_avx2(const std::int64_t *v, std::int64_t c, std::size_t n,
+                std::uint64_t *out) {
+  constexpr bool negate = (Op == column_op_type::NE ||
+                           Op == column_op_type::LE ||
+                           Op == column_op_type::GE);
+  const auto cv = _mm256_set1_epi64x(c);
+
+  auto full = n / 64;
+  for (std::size_t w = 0; w < full; ++w) {
+    std::uint64_t bits = 0;
+    for (std::size_t j = 0; j < 64; j += 4) {
+      auto x = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(v + w * 64 + j));
+
+      __m256i m;
+      if constexpr (Op == column_op_type::EQ || Op == column_op_type::NE) {
+        m = _mm256_cmpeq_epi64(x, cv);
+      } else if constexpr (Op == column_op_type::GT ||
+                           Op == column_op_type::LE) {
+        m = _mm256_cmpgt_epi64(x, cv);
+      } else {
+        m = _mm256_cmpgt_epi64(cv, x);
+      }
+
+      bits |= static_cast<std::uint64_t>(
+                  _mm256_movemask_pd(_mm256_castsi256_pd(m)))
+              << j;
+    }
+    out[w] = negate ? ~bits : bits;
+  }
+
+  if (n % 64) {
+    int_kernel<Op>(v + full * 64, c, n % 64, out + full);
+  }
+}
+#endif
+
+using int_kernel_fn = void (*)(const std::int64_t *, std::int64_t,
+                               std::size_t, std::uint64_t *);
+
+int_kernel_fn select_int_kernel(column_op_type op, bool simd) {
+#if defined(NFORCE_HAS_AVX2)
+  if (simd) {
+    switch (op) {
+    case column_op_type::EQ:
+      return int_kernel_avx2<column_op_type::EQ>;
+    case column_op_type::NE:
+      return int_kernel_avx2<column_op_type::NE>;
+    case column_op_type::LT:
+      return int_kernel_avx2<column_op_type::LT>;
+    case column_op_type::LE:
+      return int_kernel_avx2<column_op_type::LE>;
+    case column_op_type::GT:
+      return int_kernel_avx2<column_op_type::GT>;
+    default:
+      return int_kernel_avx2<column_op_type::GE>;
+    }
+  }
+#else
+  (void)simd;
+#endif
+
+  switch (op) {
+  case column_op_type::EQ:
+    return int_kernel<column_op_type::EQ>;
+  case column_op_type::NE:
+    return int_kernel<column_op_type::NE>;
+  case column_op_type::LT:
+    return int_kernel<column_op_type::LT>;
+  case column_op_type::LE:
+    return int_kernel<column_op_type::LE>;
+  case column_op_type::GT:
+    return int_kernel<column_op_type::GT>;
+  default:
+    return int_kernel<column_op_type::GE>;
+  }
+}
+
+bool has_avx2() {
+#if defined(NFORCE_HAS_AVX2)
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+// match bits of rows [first, first + n) for a rule
+void leaf_kernel(const column_set::rule &r, std::size_t first, std::size_t n,
+                 bool simd, std::uint64_t *out) {
+  const auto &col = *r.col;
+  if (col.values) {
+    select_int_kernel(r.op, simd)(col.values + first, r.value, n, out);
+    return;
+  }
+
+  std::string_view text{r.text};
+  switch (r.op) {
+  case column_op_type::EQ:
+  case column_op_type::NE: {
+    auto eq = (r.op == column_op_type::EQ);
+    scalar_kernel(n, out, [&](std::size_t i) {
+      auto len = col.offsets[first + i + 1] - col.offsets[first + i];
+      return (len == text.size() &&
+              std::memcmp(col.bytes + col.offsets[first + i], text.data(),
+                          len) == 0) == eq;
+    });
+    break;
+  }
+  case column_op_type::PREFIX:
+    scalar_kernel(n, out, [&](std::size_t i) {
+      auto len = col.offsets[first + i + 1] - col.offsets[first + i];
+      return len >= text.size() &&
+             std::memcmp(col.bytes + col.offsets[first + i], text.data(),
+                         text.size()) == 0;
+    });
+    break;
+  default:
+    scalar_kernel(n, out, [&](std::size_t i) {
+      return str_value(col, first + i).find(text) != std::string_view::npos;
+    });
+    break;
+  }
+}
+} // namespace
+
+//-------------------------------------
+// Public
+
+void column_set::add(const std::string &name, const std::int64_t *values) {
+  m_columns[name] = column{values, nullptr, nullptr};
+}
+
+void column_set::add(const std::string &name, const std::uint32_t *offsets,
+                     const char *bytes) {
+  m_columns[name] = column{nullptr, offsets, bytes};
+}
+
+const column_set::column *column_set::find(const std::string &name) const {
+  auto hit = m_columns.find(name);
+  return (hit == std::cend(m_columns)) ? nullptr : &hit->second;
+}
+
+bool column_set::parse(const std::string &str, rule &r) const {
+  auto pos = str.find_first_of(op_chars);
+  if (pos == 0 || pos == std::string::npos || pos + 1 >= str.size()) {
+    return false;
+  }
+
+  r.col = this->find(str.substr(0, pos));
+  if (!r.col) {
+    return false;
+  }
+
+  auto len = std::size_t{2};
+  auto op = str.substr(pos, 2);
+  if (op == "==") {
+    r.op = column_op_type::EQ;
+  } else if (op == "!=") {
+    r.op = column_op_type::NE;
+  } else if (op == "<=") {
+    r.op = column_op_type::LE;
+  } else if (op == ">=") {
+    r.op = column_op_type::GE;
+  } else if (op == "^=") {
+    r.op = column_op_type::PREFIX;
+  } else if (op == "*=") {
+    r.op = column_op_type::CONTAINS;
+  } else if (op[0] == '<' || op[0] == '>') {
+    r.op = (op[0] == '<') ? column_op_type::LT : column_op_type::GT;
+    len = 1;
+  } else {
+    return false;
+  }
+
+  r.text = str.substr(pos + len);
+  if (!r.col->values) {
+    return is_string_op(r.op);
+  }
+
+  if (r.op == column_op_type::PREFIX || r.op == column_op_type::CONTAINS) {
+    return false;
+  }
+
+  auto last = r.text.data() + r.text.size();
+  auto res = std::from_chars(r.text.data(), last, r.value);
+  return res.ec == std::errc{} && res.ptr == last;
+}
+
+parser::rule_handler column_set::handler(const std::size_t &row) const {
+  auto rules = std::make_shared<std::unordered_map<std::string, rule>>();
+
+  return {[this, rules](const std::string &str) {
+            rule r;
+            if (!this->parse(str, r)) {
+              return false;
+            }
+            rules->emplace(str, std::move(r));
+            return true;
+          },
+          [rules, &row](const std::string &str) {
+            auto hit = rules->find(str);
+            if (hit == std::cend(*rules)) {
+              throw nexcept("[nforce] unknown column rule " + str,
+                            status_type::INTERNAL_ERROR);
+            }
+            return eval_row(hit->second, row);
+          }};
+}
+
+columnar_scan::columnar_scan(const expr &root, const column_set &cols,
+                             const columnar_options &opts)
+    : m_cols{cols}, m_leaves{root},
+      m_simd{opts.simd && has_avx2()} {
+  for (std::size_t i = 0; i < m_leaves.size(); ++i) {
+    column_set::rule r;
+    if (!cols.parse(m_leaves[i].rule(), r)) {
+      throw nexcept("[nforce] no column for rule " + m_leaves[i].rule(),
+                    status_type::BAD_PARSE);
+    }
+    m_rules.push_back(std::move(r));
+  }
+
+  // the leaf set already checked the tree is complete
+  columnar_compiler compiler{m_leaves, m_program};
+  root.accept(compiler);
+  m_depth = compiler.depth();
+
+  m_block_words = std::max<std::size_t>(1, (opts.block_rows + 63) / 64);
+}
+
+columnar_scan::~columnar_scan() = default;
+
+void columnar_scan::scan(std::size_t first, std::size_t count,
+                         bitmap &out) const {
+  if (first > m_cols.rows() || count > m_cols.rows() - first) {
+    throw nexcept("[nforce] out of range scan", status_type::INTERNAL_ERROR);
+  }
+
+  out.assign((count + 63) / 64, 0);
+
+  auto words = m_block_words;
+  std::vector<std::uint64_t> leaves(m_leaves.size() * words);
+  std::vector<bool> computed(m_leaves.size());
+  std::vector<std::uint64_t> stack(m_depth * words);
+
+  for (std::size_t b = 0; b * words * 64 < count; ++b) {
+    auto row = first + b * words * 64;
+    auto n = std::min(words * 64, count - b * words * 64);
+    auto nw = (n + 63) / 64;
+    std::fill(std::begin(computed), std::end(computed), false);
+
+    std::size_t top = 0;
+    for (const auto &i : m_program) {
+      switch (i.type) {
+      case instr::kind::LEAF: {
+        auto bits = &leaves[i.arg * words];
+        if (!computed[i.arg]) {
+          leaf_kernel(m_rules[i.arg], row, n, m_simd, bits);
+          computed[i.arg] = true;
+        }
+        std::copy(bits, bits + nw, &stack[top++ * words]);
+        break;
+      }
+      case instr::kind::NOT: {
+        auto bits = &stack[(top - 1) * words];
+        for (std::size_t w = 0; w < nw; ++w) {
+          bits[w] = ~bits[w];
+        }
+        break;
+      }
+      case instr::kind::AND:
+      case instr::kind::OR: {
+        auto dst = &stack[(top - i.arg) * words];
+        for (std::size_t k = 1; k < i.arg; ++k) {
+          auto src = &stack[(top - i.arg + k) * words];
+          for (std::size_t w = 0; w < nw; ++w) {
+            dst[w] = (i.type == instr::kind::AND) ? (dst[w] & src[w])
+                                                  : (dst[w] | src[w]);
+          }
+        }
+        top -= i.arg - 1;
+        break;
+      }
+      }
+    }
+
+    std::copy(&stack[0], &stack[0] + nw, &out[b * words]);
+  }
+
+  // clear bits past the slice
+  if (count % 64) {
+    out.back() &= (std::uint64_t{1} << (count % 64)) - 1;
+  }
+}
+
+bitmap columnar_scan::scan() const {
+  bitmap out;
+  this->scan(0, m_cols.rows(), out);
+  return out;
+}
+
+std::size_t match_count(const bitmap &bits, std::size_t count) {
+  std::size_t res = 0;
+  for (std::size_t w = 0; w * 64 < count && w < bits.size(); ++w) {
+    auto word = bits[w];
+    if ((w + 1) * 64 > count) {
+      word &= (std::uint64_t{1} << (count % 64)) - 1;
+    }
+    res += std::bitset<64>(word).count();
+  }
+  return res;
+}
+} // namespace n4
@@ -0,0 +1,122 @@
+#include "nforce/cost.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/leaves.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+class cost_analyzer final : public expr_visitor {
+public:
+  // cost of a sub expression and probability that it holds
+  struct node_cost {
+    std::size_t nodes{0};
+    std::size_t depth{0};
+    double worst{0.0};
+    double expected{0.0};
+    double holds{0.0};
+  };
+
+  node_cost analyze(const expr *e) {
+    if (!e) {
+      throw nexcept("[nforce] missing operand", status_type::BAD_AST);
+    }
+    e->accept(*this);
+    return m_result;
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::OR> &e) override {
+    this->combine<binary_op_type::OR>({e.left_op(), e.right_op()});
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::AND> &e) override {
+    this->combine<binary_op_type::AND>({e.left_op(), e.right_op()});
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::OR> &e) override {
+    this->combine<binary_op_type::OR>(this->operands(e));
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::AND> &e) override {
+    this->combine<binary_op_type::AND>(this->operands(e));
+  }
+
+  void visit(const unary_not_expr &e) override {
+    auto c = this->analyze(e.op());
+    ++c.nodes;
+    ++c.depth;
+    c.holds = 1.0 - c.holds;
+    m_result = c;
+  }
+
+  void visit(const rule_expr &e) override {
+    const auto &hint = e.cost();
+    m_result = {1, 1, hint.worst, hint.expected,
+                std::clamp(hint.selectivity, 0.0, 1.0)};
+  }
+
+private:
+  template <binary_op_type Op>
+  static std::vector<const expr *> operands(const nary_gen_expr<Op> &e) {
+    if (e.size() == 0) {
+      throw nexcept("[nforce] missing n-ary operand", status_type::BAD_AST);
+    }
+    std::vector<const expr *> ops;
+    for (std::size_t i = 0; i < e.size(); ++i) {
+      ops.push_back(e.op(i));
+    }
+    return ops;
+  }
+
+  template <binary_op_type Op>
+  void combine(const std::vector<const expr *> &ops) {
+    // an operand is reached when all the previous ones left the node
+    // undecided: true for AND, false for OR
+    node_cost res{1, 0, 0.0, 0.0, 0.0};
+    double reached = 1.0;
+    for (const auto *op : ops) {
+      auto c = this->analyze(op);
+      res.nodes += c.nodes;
+      res.depth = std::max(res.depth, c.depth);
+      res.worst += c.worst;
+      res.expected += reached * c.expected;
+      reached *= (Op == binary_op_type::AND) ? c.holds : 1.0 - c.holds;
+    }
+    ++res.depth;
+    res.holds = (Op == binary_op_type::AND) ? reached : 1.0 - reached;
+    m_result = res;
+  }
+
+  node_cost m_result;
+};
+} // namespace
+
+
+//-------------------------------------
+// Public
+
+expr_cost static_cost(const expr &root) {
+  auto c = cost_analyzer{}.analyze(&root);
+
+  expr_cost res;
+  res.nodes = c.nodes;
+  res.depth = c.depth;
+  res.leaves = leaf_set{root}.size();
+  res.worst = c.worst;
+  res.expected = c.expected;
+  return res;
+}
+
+bool within(const expr_cost &cost, const cost_budget &budget) {
+  return (!budget.nodes || cost.nodes <= budget.nodes) &&
+         (!budget.depth || cost.depth <= budget.depth) &&
+         (!budget.leaves || cost.leaves <= budget.leaves) &&
+         (!(budget.worst > 0.0) || cost.worst <= budget.worst) &&
+         (!(budget.expected > 0.0) || cost.expected <= budget.expected);
+}
+} // namespace n4
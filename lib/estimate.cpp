@@ -0,0 +1,154 @@
+#include "nforce/estimate.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/leaves.h"
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <unordered_map>
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+// upper quantile of the standard normal distribution for a two-sided
+// confidence, rational approximation with an error below 4.5e-4
+double normal_quantile(double confidence) {
+  auto t = std::sqrt(-2.0 * std::log((1.0 - confidence) / 2.0));
+  return t - (2.515517 + 0.802853 * t + 0.010328 * t * t) /
+                 (1.0 + 1.432788 * t + 0.189269 * t * t +
+                  0.001308 * t * t * t);
+}
+
+struct bounds {
+  double low;
+  double high;
+};
+
+// Wilson score interval of the fraction of a population matching, given
+// matched records out of sampled ones, the finite population correction
+// shrinking it down to the exact value once every record is sampled
+bounds wilson(std::size_t matched, std::size_t sampled,
+              std::size_t population, double z) {
+  auto n = static_cast<double>(sampled);
+  auto size = static_cast<double>(population);
+
+  // unsampled records all matching or none of them
+  bounds hard{matched / size, (matched + size - n) / size};
+  if (sampled == 0 || sampled == population) {
+    return hard;
+  }
+
+  auto z2 = z * z * (size - n) / (size - 1.0);
+  auto p = matched / n;
+  auto denom = 1.0 + z2 / n;
+  auto center = (p + z2 / (2.0 * n)) / denom;
+  auto half =
+      std::sqrt(z2 * (p * (1.0 - p) / n + z2 / (4.0 * n * n))) / denom;
+  return {std::max(hard.low, center - half),
+          std::min(hard.high, center + half)};
+}
+
+// random order over a range, drawing without replacement through a
+// Fisher-Yates shuffle only materializing the swapped positions
+class sampler final {
+public:
+  sampler(std::size_t first, std::size_t last, std::uint64_t seed)
+      : m_first{first}, m_size{last - first}, m_gen{seed} {}
+
+  std::size_t next() {
+    std::uniform_int_distribution<std::size_t> pick{m_drawn, m_size - 1};
+    auto j = pick(m_gen);
+    auto record = this->at(j);
+    m_swaps[j] = this->at(m_drawn);
+    m_swaps.erase(m_drawn++);
+    return m_first + record;
+  }
+
+private:
+  std::size_t at(std::size_t i) const {
+    auto it = m_swaps.find(i);
+    return it == std::cend(m_swaps) ? i : it->second;
+  }
+
+  std::size_t m_first;
+  std::size_t m_size;
+  std::size_t m_drawn{0};
+  std::mt19937_64 m_gen;
+  std::unordered_map<std::size_t, std::size_t> m_swaps;
+};
+} // namespace
+
+//-------------------------------------
+// Public
+
+count_estimate estimate_count(const expr &root, std::size_t first,
+                              std::size_t last, const record_loader &load,
+                              const estimate_options &opts) {
+  if (first > last) {
+    throw nexcept("[nforce] invalid estimate range",
+                  status_type::INTERNAL_ERROR);
+  }
+  if (!(opts.confidence > 0.0 && opts.confidence < 1.0) ||
+      !(opts.precision >= 0.0)) {
+    throw nexcept("[nforce] invalid estimate options",
+                  status_type::INTERNAL_ERROR);
+  }
+
+  std::optional<leaf_set> leaves;
+  if (opts.leaf_selectivity) {
+    leaves.emplace(root);
+  }
+
+  count_estimate res;
+  res.population = last - first;
+  std::vector<std::size_t> leaf_matches(leaves ? leaves->size() : 0);
+
+  auto z = normal_quantile(opts.confidence);
+  auto limit = opts.max_sample ? std::min(opts.max_sample, res.population)
+                               : res.population;
+  sampler s{first, last, opts.seed};
+
+  while (res.sampled < limit) {
+    load(s.next());
+    res.matched += root.interpret() ? 1 : 0;
+    for (std::size_t k = 0; k < leaf_matches.size(); ++k) {
+      leaf_matches[k] += (*leaves)[k].interpret() ? 1 : 0;
+    }
+    ++res.sampled;
+
+    if (res.sampled >= opts.min_sample) {
+      auto b = wilson(res.matched, res.sampled, res.population, z);
+      if (b.high - b.low <= 2.0 * opts.precision) {
+        break;
+      }
+    }
+  }
+
+  if (res.population == 0) {
+    return res;
+  }
+
+  auto size = static_cast<double>(res.population);
+  auto b = wilson(res.matched, res.sampled, res.population, z);
+  res.count = res.sampled ? size * res.matched / res.sampled : 0.0;
+  res.low = size * b.low;
+  res.high = size * b.high;
+
+  for (std::size_t k = 0; k < leaf_matches.size(); ++k) {
+    auto lb = wilson(leaf_matches[k], res.sampled, res.population, z);
+    leaf_estimate l;
+    l.rule = (*leaves)[k].rule();
+    l.matched = leaf_matches[k];
+    l.selectivity =
+        res.sampled ? static_cast<double>(l.matched) / res.sampled : 0.0;
+    l.low = lb.low;
+    l.high = lb.high;
+    res.leaves.push_back(std::move(l));
+  }
+  return res;
+}
+} // namespace n4
@@ -0,0 +1,159 @@
+#include <exception>
+
+#include "nforce/executor.h"
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+void executor::run(std::size_t w) {
+  task t;
+  for (;;) {
+    if (this->pop(w, t)) {
+      try {
+        t(w);
+      } catch (...) {
+        // nobody waits on a submitted task, keep the worker alive
+      }
+      t = nullptr;
+      --m_busy;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_cv.wait(lock, [this] { return m_stop || m_pending.load() > 0; });
+    if (m_stop && m_pending.load() == 0) {
+      return;
+    }
+  }
+}
+
+bool executor::pop(std::size_t w, task &t) {
+  if (m_pending.load() == 0) {
+    return false;
+  }
+
+  // own queue first (newest task), then steal (oldest task)
+  for (std::size_t i = 0; i < m_queues.size(); ++i) {
+    auto &q = *m_queues[(w + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock{q.mutex};
+    if (q.tasks.empty()) {
+      continue;
+    }
+
+    if (i == 0) {
+      t = std::move(q.tasks.back());
+      q.tasks.pop_back();
+    } else {
+      t = std::move(q.tasks.front());
+      q.tasks.pop_front();
+    }
+    ++m_busy;
+    --m_pending;
+    return true;
+  }
+
+  return false;
+}
+
+void executor::push(std::size_t w, task t) {
+  auto &q = *m_queues[w];
+  std::lock_guard<std::mutex> lock{q.mutex};
+  q.tasks.push_back(std::move(t));
+  ++m_pending;
+}
+
+void executor::notify(std::size_t count) {
+  {
+    // avoid lost wake up between pending check and wait
+    std::lock_guard<std::mutex> lock{m_mutex};
+  }
+
+  if (count == 1) {
+    m_cv.notify_one();
+  } else {
+    m_cv.notify_all();
+  }
+}
+
+//-------------------------------------
+// Public
+
+executor::executor(std::size_t threads) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (std::size_t i = 0; i < threads; ++i) {
+    m_queues.push_back(std::make_unique<worker_queue>());
+  }
+
+  for (std::size_t i = 0; i < threads; ++i) {
+    m_threads.emplace_back([this, i] { this->run(i); });
+  }
+}
+
+executor::~executor() {
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_stop = true;
+  }
+  m_cv.notify_all();
+
+  for (auto &t : m_threads) {
+    t.join();
+  }
+}
+
+void executor::submit(task t) {
+  this->push(m_next++ % m_queues.size(), std::move(t));
+  this->notify(1);
+}
+
+void executor::bulk(std::size_t count,
+                    const std::function<void(std::size_t, std::size_t)> &f) {
+  if (count == 0) {
+    return;
+  }
+
+  std::size_t remaining{count};
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable done;
+
+  auto workers = m_queues.size();
+  for (std::size_t w = 0; w < workers; ++w) {
+    auto first = w * count / workers;
+    auto last = (w + 1) * count / workers;
+
+    // queue in reverse so that the owner pops the range in order
+    for (auto i = last; i-- > first;) {
+      this->push(w, [&, i](std::size_t worker) {
+        std::exception_ptr e;
+        try {
+          f(i, worker);
+        } catch (...) {
+          e = std::current_exception();
+        }
+
+        // the waiting caller may return as soon as the lock is released
+        std::lock_guard<std::mutex> lock{mutex};
+        if (e && !error) {
+          error = e;
+        }
+        if (--remaining == 0) {
+          done.notify_all();
+        }
+      });
+    }
+  }
+  this->notify(count);
+
+  std::unique_lock<std::mutex> lock{mutex};
+  done.wait(lock, [&] { return remaining == 0; });
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+} // namespace n4
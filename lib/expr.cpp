@@ -0,0 +1,79 @@
+#include <vector>
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+std::unique_ptr<expr> flatten_node(std::unique_ptr<expr> e);
+
+// gather operands of nested same operator nodes without recursion
+template <binary_op_type Op>
+std::unique_ptr<expr> flatten_chain(std::unique_ptr<expr> e) {
+  auto res = std::make_unique<nary_gen_expr<Op>>();
+
+  std::vector<std::unique_ptr<expr>> stack;
+  stack.push_back(std::move(e));
+  while (!stack.empty()) {
+    auto curr = std::move(stack.back());
+    stack.pop_back();
+
+    if (!curr) {
+      throw nexcept("[nforce] missing operand", status_type::BAD_AST);
+    }
+
+    if (auto b = dynamic_cast<binary_gen_expr<Op> *>(curr.get())) {
+      stack.push_back(b->release_right_op());
+      stack.push_back(b->release_left_op());
+    } else if (auto n = dynamic_cast<nary_gen_expr<Op> *>(curr.get())) {
+      auto ops = n->release_ops();
+      for (auto it = std::rbegin(ops); it != std::rend(ops); ++it) {
+        stack.push_back(std::move(*it));
+      }
+    } else {
+      res->add_op(flatten_node(std::move(curr)));
+    }
+  }
+
+  if (res->size() == 1) {
+    return std::move(res->release_ops().front());
+  }
+  return res;
+}
+
+template <binary_op_type Op> bool is_chain(const expr *e) {
+  return dynamic_cast<const binary_gen_expr<Op> *>(e) ||
+         dynamic_cast<const nary_gen_expr<Op> *>(e);
+}
+
+std::unique_ptr<expr> flatten_node(std::unique_ptr<expr> e) {
+  if (!e) {
+    throw nexcept("[nforce] missing expression", status_type::BAD_AST);
+  }
+
+  if (is_chain<binary_op_type::AND>(e.get())) {
+    return flatten_chain<binary_op_type::AND>(std::move(e));
+  }
+
+  if (is_chain<binary_op_type::OR>(e.get())) {
+    return flatten_chain<binary_op_type::OR>(std::move(e));
+  }
+
+  if (auto u = dynamic_cast<unary_not_expr *>(e.get())) {
+    u->set_op(flatten_node(u->release_op()));
+  }
+
+  return e;
+}
+} // namespace
+
+//-------------------------------------
+// Public
+
+std::unique_ptr<expr> flatten(std::unique_ptr<expr> root) {
+  return flatten_node(std::move(root));
+}
+} // namespace n4
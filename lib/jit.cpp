@@ -0,0 +1,283 @@
+#include "nforce/jit.h"
+#include "nforce/core/except.h"
+#include "nforce/leaves.h"
+
+#include <cstring>
+#include <exception>
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(NFORCE_NO_JIT)
+#define NFORCE_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+// results exchanged between generated code and leaves
+constexpr std::uint8_t leaf_false = 0;
+constexpr std::uint8_t leaf_true = 1;
+constexpr std::uint8_t leaf_error = 2;
+
+thread_local std::exception_ptr t_error;
+
+#ifdef NFORCE_JIT
+// generated code has no unwind information, exceptions are stopped here
+// and rethrown once back in interpret
+std::uint8_t call_leaf(const rule_expr *leaf) {
+  try {
+    return leaf->interpret() ? leaf_true : leaf_false;
+  } catch (...) {
+    t_error = std::current_exception();
+    return leaf_error;
+  }
+}
+#endif
+} // namespace
+
+#ifdef NFORCE_JIT
+///
+/// Each node is compiled as jumping code: given the labels to reach when
+/// it is true or false, and the label emitted right after it so that the
+/// matching jump can be omitted.
+///
+class jit_compiler final : public expr_visitor {
+public:
+  std::vector<std::uint8_t> compile(const expr &root) {
+    auto t = this->make_label();
+    auto f = this->make_label();
+    m_error = this->make_label();
+
+    // push rbx, keeps the stack 16 bytes aligned for leaf calls
+    this->emit({0x53});
+    this->branch(&root, t, f, t);
+
+    // mov eax, imm32; pop rbx; ret
+    for (auto [l, value] : {std::pair{t, leaf_true}, std::pair{f, leaf_false},
+                            std::pair{m_error, leaf_error}}) {
+      this->bind(l);
+      this->emit({0xB8, value, 0x00, 0x00, 0x00, 0x5B, 0xC3});
+    }
+
+    for (const auto &[pos, l] : m_fixups) {
+      auto rel = static_cast<std::int32_t>(m_labels[l] - (pos + 4));
+      std::memcpy(&m_code[pos], &rel, sizeof(rel));
+    }
+    return std::move(m_code);
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::OR> &e) override {
+    this->chain<binary_op_type::OR>({e.left_op(), e.right_op()});
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::AND> &e) override {
+    this->chain<binary_op_type::AND>({e.left_op(), e.right_op()});
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::OR> &e) override {
+    this->chain<binary_op_type::OR>(this->operands(e));
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::AND> &e) override {
+    this->chain<binary_op_type::AND>(this->operands(e));
+  }
+
+  void visit(const unary_not_expr &e) override {
+    this->branch(e.op(), m_false, m_true, m_next);
+  }
+
+  void visit(const rule_expr &e) override {
+    auto t = m_true;
+    auto f = m_false;
+
+    // mov rdi, leaf; mov rax, call_leaf; call rax; cmp al, 1
+    this->emit({0x48, 0xBF});
+    this->emit_imm64(reinterpret_cast<std::uintptr_t>(&e));
+    this->emit({0x48, 0xB8});
+    this->emit_imm64(reinterpret_cast<std::uintptr_t>(&call_leaf));
+    this->emit({0xFF, 0xD0, 0x3C, 0x01});
+
+    // ja error, then jump to the result not emitted next
+    this->jump({0x0F, 0x87}, m_error);
+    if (m_next == t) {
+      this->jump({0x0F, 0x85}, f);
+    } else if (m_next == f) {
+      this->jump({0x0F, 0x84}, t);
+    } else {
+      this->jump({0x0F, 0x84}, t);
+      this->jump({0xE9}, f);
+    }
+  }
+
+private:
+  using label = std::size_t;
+
+  label make_label() {
+    m_labels.push_back(0);
+    return m_labels.size() - 1;
+  }
+
+  void bind(label l) { m_labels[l] = m_code.size(); }
+
+  void emit(std::initializer_list<std::uint8_t> bytes) {
+    m_code.insert(m_code.end(), bytes);
+  }
+
+  void emit_imm64(std::uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+      m_code.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+  }
+
+  // opcode followed by a rel32 patched once labels are bound
+  void jump(std::initializer_list<std::uint8_t> opcode, label l) {
+    this->emit(opcode);
+    m_fixups.emplace_back(m_code.size(), l);
+    this->emit({0x00, 0x00, 0x00, 0x00});
+  }
+
+  void branch(const expr *e, label t, label f, label next) {
+    if (!e) {
+      throw nexcept("[nforce] missing operand", status_type::BAD_AST);
+    }
+
+    auto saved = std::make_tuple(m_true, m_false, m_next);
+    m_true = t;
+    m_false = f;
+    m_next = next;
+    e->accept(*this);
+    std::tie(m_true, m_false, m_next) = saved;
+  }
+
+  template <binary_op_type Op>
+  std::vector<const expr *> operands(const nary_gen_expr<Op> &e) const {
+    if (e.size() == 0) {
+      throw nexcept("[nforce] empty n-ary expression", status_type::BAD_AST);
+    }
+
+    std::vector<const expr *> ops;
+    for (std::size_t i = 0; i < e.size(); ++i) {
+      ops.push_back(e.op(i));
+    }
+    return ops;
+  }
+
+  // every operand but the last one continues with the next operand when
+  // it does not decide the result
+  template <binary_op_type Op>
+  void chain(const std::vector<const expr *> &ops) {
+    auto t = m_true;
+    auto f = m_false;
+    auto next = m_next;
+
+    for (std::size_t i = 0; i + 1 < ops.size(); ++i) {
+      auto cont = this->make_label();
+      if constexpr (Op == binary_op_type::AND) {
+        this->branch(ops[i], cont, f, cont);
+      } else {
+        this->branch(ops[i], t, cont, cont);
+      }
+      this->bind(cont);
+    }
+    this->branch(ops.back(), t, f, next);
+  }
+
+  std::vector<std::uint8_t> m_code;
+  std::vector<std::size_t> m_labels;
+  std::vector<std::pair<std::size_t, label>> m_fixups;
+  label m_true{0};
+  label m_false{0};
+  label m_next{0};
+  label m_error{0};
+};
+#endif
+
+//-------------------------------------
+// Public
+
+jit_expr::jit_expr(std::unique_ptr<expr> &&root) {
+  if (!root) {
+    throw nexcept("[nforce] missing expression", status_type::BAD_AST);
+  }
+
+#ifdef NFORCE_JIT
+  jit_compiler compiler;
+  auto code = compiler.compile(*root);
+
+  auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  auto mapped = (code.size() + page - 1) / page * page;
+
+  // written then sealed, the mapping is never writable and executable
+  auto *mem = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    throw nexcept("[nforce] cannot map native code",
+                  status_type::INTERNAL_ERROR);
+  }
+
+  std::memcpy(mem, code.data(), code.size());
+  if (::mprotect(mem, mapped, PROT_READ | PROT_EXEC) != 0) {
+    ::munmap(mem, mapped);
+    throw nexcept("[nforce] cannot protect native code",
+                  status_type::INTERNAL_ERROR);
+  }
+
+  m_code = mem;
+  m_size = code.size();
+  m_mapped = mapped;
+  m_root = std::move(root);
+#else
+  throw nexcept("[nforce] native code generation unavailable",
+                status_type::INTERNAL_ERROR);
+#endif
+}
+
+jit_expr::~jit_expr() {
+#ifdef NFORCE_JIT
+  if (m_code) {
+    ::munmap(m_code, m_mapped);
+  }
+#endif
+}
+
+bool jit_expr::interpret() const {
+  auto result = reinterpret_cast<entry>(m_code)();
+  if (result == leaf_error) {
+    std::rethrow_exception(std::exchange(t_error, nullptr));
+  }
+  return result == leaf_true;
+}
+
+bool jit_expr::available() {
+#ifdef NFORCE_JIT
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::unique_ptr<expr> compile_jit(std::unique_ptr<expr> root) {
+  if (!root) {
+    throw nexcept("[nforce] missing expression", status_type::BAD_AST);
+  }
+
+  // report incomplete expressions, only fall back when code cannot be
+  // generated or mapped
+  leaf_set{*root};
+
+  try {
+    return std::make_unique<jit_expr>(std::move(root));
+  } catch (const nexcept &e) {
+    if (e.status() != status_type::INTERNAL_ERROR) {
+      throw;
+    }
+    return root;
+  }
+}
+} // namespace n4
@@ -0,0 +1,99 @@
+#include "nforce/leaves.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+class leaf_collector final : public expr_visitor {
+public:
+  leaf_collector(
+      std::vector<const rule_expr *> &leaves, std::vector<std::size_t> &counts,
+      std::unordered_map<std::string, std::size_t> &by_rule,
+      std::unordered_map<const rule_expr *, std::size_t> &by_node)
+      : m_leaves{leaves}, m_counts{counts}, m_by_rule{by_rule},
+        m_by_node{by_node} {}
+
+  void visit(const binary_gen_expr<binary_op_type::OR> &e) override {
+    this->binary(e.left_op(), e.right_op());
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::AND> &e) override {
+    this->binary(e.left_op(), e.right_op());
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::OR> &e) override {
+    this->nary(e);
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::AND> &e) override {
+    this->nary(e);
+  }
+
+  void visit(const unary_not_expr &e) override {
+    if (!e.op()) {
+      throw nexcept("[nforce] missing unary operand", status_type::BAD_AST);
+    }
+    e.op()->accept(*this);
+  }
+
+  void visit(const rule_expr &e) override {
+    auto index = m_leaves.size();
+    if (!e.rule().empty()) {
+      index = m_by_rule.emplace(e.rule(), index).first->second;
+    }
+
+    if (index == m_leaves.size()) {
+      m_leaves.push_back(&e);
+      m_counts.push_back(0);
+    }
+    ++m_counts[index];
+    m_by_node.emplace(&e, index);
+  }
+
+private:
+  void binary(const expr *op1, const expr *op2) {
+    if (!op1 || !op2) {
+      throw nexcept("[nforce] missing binary operand", status_type::BAD_AST);
+    }
+    op1->accept(*this);
+    op2->accept(*this);
+  }
+
+  template <binary_op_type Op> void nary(const nary_gen_expr<Op> &e) {
+    if (e.size() == 0) {
+      throw nexcept("[nforce] missing n-ary operand", status_type::BAD_AST);
+    }
+    for (std::size_t i = 0; i < e.size(); ++i) {
+      if (!e.op(i)) {
+        throw nexcept("[nforce] missing n-ary operand", status_type::BAD_AST);
+      }
+      e.op(i)->accept(*this);
+    }
+  }
+
+  std::vector<const rule_expr *> &m_leaves;
+  std::vector<std::size_t> &m_counts;
+  std::unordered_map<std::string, std::size_t> &m_by_rule;
+  std::unordered_map<const rule_expr *, std::size_t> &m_by_node;
+};
+} // namespace
+
+//-------------------------------------
+// Public
+
+leaf_set::leaf_set(const expr &root) {
+  leaf_collector collector{m_leaves, m_counts, m_by_rule, m_by_node};
+  root.accept(collector);
+}
+
+std::size_t leaf_set::index_of(const rule_expr &leaf) const {
+  auto hit = m_by_node.find(&leaf);
+  if (hit == std::cend(m_by_node)) {
+    throw nexcept("[nforce] unknown leaf", status_type::INTERNAL_ERROR);
+  }
+  return hit->second;
+}
+} // namespace n4
@@ -4,6 +4,7 @@
 
 #include "nforce/core/except.h"
 #include "nforce/lexer.h"
+#include "nforce/trace.h"
 
 namespace n4 {
 //-------------------------------------
@@ -46,6 +47,8 @@ lexer::lexer(const std::string &input) : m_in{input} {
 }
 
 token lexer::next() {
+  NFORCE_TRACE_SPAN(trace_lex, trace_phase::LEX);
+
   if (m_is_end) {
     throw nexcept(std::string("[nforce] out of range token search"),
                   status_type::INTERNAL_ERROR);
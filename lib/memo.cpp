@@ -0,0 +1,140 @@
+#include "nforce/memo.h"
+#include "nforce/core/except.h"
+
+#include <algorithm>
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+class memo_expr::cache final {
+public:
+  cache(std::string rule, std::size_t capacity) : m_rule{std::move(rule)} {
+    std::size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    m_slots.resize(size);
+    m_mask = size - 1;
+  }
+
+  template <typename F> bool get(std::string_view value, const F &compute) {
+    auto h = std::hash<std::string_view>{}(value);
+    auto &s = m_slots[h & m_mask];
+    if (s.used && s.hash == h && s.key == value) {
+      ++m_hits;
+      return s.result;
+    }
+
+    ++m_misses;
+    auto result = compute();
+    s.used = true;
+    s.hash = h;
+    s.key.assign(value.data(), value.size());
+    s.result = result;
+    return result;
+  }
+
+  const std::string &rule() const { return m_rule; }
+
+  memo_stats stats() const { return {m_rule, m_hits, m_misses}; }
+
+private:
+  struct slot {
+    std::string key;
+    std::size_t hash{0};
+    bool result{false};
+    bool used{false};
+  };
+
+  std::string m_rule;
+  std::vector<slot> m_slots;
+  std::size_t m_mask{0};
+  std::size_t m_hits{0};
+  std::size_t m_misses{0};
+};
+
+namespace {
+template <typename Node, typename F>
+std::unique_ptr<expr> rebuild_nary(std::unique_ptr<expr> e, const F &f) {
+  auto n = static_cast<Node *>(e.get());
+  auto ops = n->release_ops();
+  for (auto &op : ops) {
+    n->add_op(f(std::move(op)));
+  }
+  return e;
+}
+} // namespace
+
+std::unique_ptr<expr> memo_expr::memoize(std::unique_ptr<expr> e,
+                                         const field_hint &hint,
+                                         const memo_options &opts) {
+  if (!e) {
+    throw nexcept("[nforce] missing operand", status_type::BAD_AST);
+  }
+
+  auto recurse = [&](std::unique_ptr<expr> op) {
+    return this->memoize(std::move(op), hint, opts);
+  };
+
+  if (auto b = dynamic_cast<binary_gen_expr<binary_op_type::AND> *>(e.get())) {
+    b->set_left_op(recurse(b->release_left_op()));
+    b->set_right_op(recurse(b->release_right_op()));
+  } else if (auto o =
+                 dynamic_cast<binary_gen_expr<binary_op_type::OR> *>(e.get())) {
+    o->set_left_op(recurse(o->release_left_op()));
+    o->set_right_op(recurse(o->release_right_op()));
+  } else if (dynamic_cast<all_of_expr *>(e.get())) {
+    e = rebuild_nary<all_of_expr>(std::move(e), recurse);
+  } else if (dynamic_cast<any_of_expr *>(e.get())) {
+    e = rebuild_nary<any_of_expr>(std::move(e), recurse);
+  } else if (auto u = dynamic_cast<unary_not_expr *>(e.get())) {
+    u->set_op(recurse(u->release_op()));
+  } else if (auto r = dynamic_cast<rule_expr *>(e.get())) {
+    auto reader = hint ? hint(*r) : field_reader{};
+    if (!reader) {
+      return e;
+    }
+
+    // leaves sharing a rule text share their cache
+    std::shared_ptr<cache> c;
+    if (!r->rule().empty()) {
+      auto it = std::find_if(
+          m_caches.begin(), m_caches.end(),
+          [r](const auto &known) { return known->rule() == r->rule(); });
+      c = (it != m_caches.end()) ? *it : nullptr;
+    }
+    if (!c) {
+      c = std::make_shared<cache>(r->rule(), opts.capacity);
+      m_caches.push_back(c);
+    }
+
+    std::shared_ptr<const expr> leaf{std::move(e)};
+    return std::make_unique<rule_expr>(
+        [leaf, reader, c] {
+          return c->get(reader(), [&leaf] { return leaf->interpret(); });
+        },
+        r->rule(), r->cost());
+  }
+
+  return e;
+}
+
+//-------------------------------------
+// Public
+
+memo_expr::memo_expr(std::unique_ptr<expr> root, const field_hint &hint,
+                     const memo_options &opts) {
+  m_root = this->memoize(std::move(root), hint, opts);
+}
+
+memo_expr::~memo_expr() = default;
+
+std::vector<memo_stats> memo_expr::stats() const {
+  std::vector<memo_stats> out;
+  for (const auto &c : m_caches) {
+    out.push_back(c->stats());
+  }
+  return out;
+}
+} // namespace n4
@@ -1,8 +1,12 @@
 #include <algorithm>
+#include <mutex>
+#include <vector>
 
 #include "nforce/core/except.h"
+#include "nforce/cost.h"
 #include "nforce/expr.h"
 #include "nforce/parser.h"
+#include "nforce/trace.h"
 
 //
 // Grammar to be parsed:
@@ -19,23 +23,84 @@
 //          -> rule
 
 namespace n4 {
+namespace {
+// rule compiled on its first evaluation, concurrent first evaluations
+// waiting for a single compilation
+class lazy_rule final {
+public:
+  lazy_rule(parser::compiler_cb compiler, std::string rule)
+      : m_compiler{std::move(compiler)}, m_rule{std::move(rule)} {}
+
+  bool interpret() {
+    std::call_once(m_once, [this] {
+      m_interpretor = m_compiler(m_rule);
+      m_compiler = nullptr;
+    });
+    return m_interpretor();
+  }
+
+private:
+  std::once_flag m_once;
+  parser::compiler_cb m_compiler;
+  std::string m_rule;
+  rule_expr::interpretor m_interpretor;
+};
+} // namespace
+
 void parser::expression() {
   // expr -> term expr'
   this->term();
-  this->eprime();
+
+  // expr' is read in a loop rather than recursively, the chain being
+  // folded from the right into n-ary nodes once complete
+  std::vector<std::unique_ptr<expr>> terms;
+  std::vector<token_type> ops;
+  terms.push_back(std::move(m_root));
+
+  while (this->eprime()) {
+    ops.push_back(m_curr.first);
+    m_curr = m_lex.next();
+    this->term();
+    terms.push_back(std::move(m_root));
+  }
+
+  // t0 op0 (t1 op1 (... tn)), each run of a same operator being one node
+  auto rest = std::move(terms.back());
+  for (auto j = ops.size(); j > 0;) {
+    auto op = ops[j - 1];
+    auto i = j - 1;
+    while (i > 0 && ops[i - 1] == op) {
+      --i;
+    }
+
+    std::unique_ptr<nary_expr> exp;
+    if (op == token_type::AND) {
+      exp = std::make_unique<all_of_expr>();
+    } else {
+      exp = std::make_unique<any_of_expr>();
+    }
+
+    for (auto k = i; k < j; ++k) {
+      exp->add_op(std::move(terms[k]));
+    }
+    exp->add_op(std::move(rest));
+
+    rest = std::move(exp);
+    j = i;
+  }
+
+  m_root = std::move(rest);
 }
 
-void parser::eprime() {
+bool parser::eprime() {
   // expr' -> | term expr'
   // expr' -> & term expr'
-  if (m_curr.first == token_type::OR) {
-    this->binary(std::make_unique<binary_gen_expr<binary_op_type::OR>>());
-  } else if (m_curr.first == token_type::AND) {
-    this->binary(std::make_unique<binary_gen_expr<binary_op_type::AND>>());
+  if (m_curr.first == token_type::OR || m_curr.first == token_type::AND) {
+    return true;
   } else if (m_curr.first == token_type::RIGHT ||
              m_curr.first == token_type::END) // First+
   {
-    return;
+    return false;
   } else {
     throw nexcept("[nforce] invalid eprime parsing", status_type::BAD_PARSE);
   }
@@ -76,15 +141,6 @@ void parser::factor() {
   }
 }
 
-void parser::binary(std::unique_ptr<binary_expr> exp) {
-  m_curr = m_lex.next();
-  exp->set_left_op(std::move(m_root));
-  this->term();
-  this->eprime();
-  exp->set_right_op(std::move(m_root));
-  m_root = std::move(exp);
-}
-
 void parser::unary(std::unique_ptr<unary_expr> exp) {
   m_curr = m_lex.next();
   this->factor();
@@ -100,18 +156,37 @@ void parser::rule() {
   }
 
   // check if it can be handled
-  auto hit = std::find_if(std::cbegin(m_handlers), std::cend(m_handlers),
-                          [&](const rule_handler &handler) {
-                            return handler.first(m_curr.second.value());
-                          });
+  auto hit = std::cend(m_handlers);
+  {
+    NFORCE_TRACE_SPAN(trace_match, trace_phase::MATCH);
+    hit = std::find_if(std::cbegin(m_handlers), std::cend(m_handlers),
+                       [&](const rule_handler &handler) {
+                         return handler.first(m_curr.second.value());
+                       });
+    NFORCE_TRACE_HANDLER(
+        trace_match,
+        hit == std::cend(m_handlers)
+            ? trace_event::no_handler
+            : static_cast<std::uint32_t>(hit - std::cbegin(m_handlers)));
+  }
 
   if (hit == std::cend(m_handlers)) {
     throw nexcept("[nforce] no handler for rule " + m_curr.second.value(),
                   status_type::BAD_PARSE);
   }
 
-  auto rexp = std::make_unique<rule_expr>(
-      std::bind(hit->second, m_curr.second.value()));
+  const auto &str = m_curr.second.value();
+  auto interp = parser::interpretor_of(*hit, str, m_opts.lazy);
+
+#ifdef NFORCE_TRACE
+  interp = [i = std::move(interp), id = current_trace_expr(),
+            h = static_cast<std::uint32_t>(hit - std::cbegin(m_handlers))] {
+    NFORCE_TRACE_SPAN(trace_interpret, trace_phase::INTERPRET, h, id);
+    return i();
+  };
+#endif
+
+  auto rexp = std::make_unique<rule_expr>(std::move(interp), str, hit->cost);
   m_root = std::move(rexp);
   m_curr = m_lex.next();
 }
@@ -119,12 +194,42 @@ void parser::rule() {
 //-------------------------------------
 // Public
 
-parser::parser(lexer &lexer, std::vector<rule_handler> &&handlerList)
-    : m_handlers{std::move(handlerList)}, m_lex{lexer} {}
+parser::parser(lexer &lexer, std::vector<rule_handler> &&handlerList,
+               const parser_options &opts)
+    : m_handlers{std::move(handlerList)}, m_lex{lexer}, m_opts{opts} {}
+
+rule_expr::interpretor parser::interpretor_of(const rule_handler &handler,
+                                              const std::string &rule,
+                                              bool lazy) {
+  if (!handler.compile) {
+    return std::bind(handler.second, rule);
+  }
+  if (lazy) {
+    auto l = std::make_shared<lazy_rule>(handler.compile, rule);
+    return [l] { return l->interpret(); };
+  }
+  return handler.compile(rule);
+}
 
 std::unique_ptr<expr> parser::build() {
+  NFORCE_TRACE_EXPR(trace_expr);
+  NFORCE_TRACE_SPAN(trace_build, trace_phase::BUILD);
+
+  m_status = status_type::SUCCESS;
   m_curr = m_lex.next();
   this->expression();
+
+  const auto &b = m_opts.budget;
+  bool limited = b.nodes || b.depth || b.leaves || b.worst > 0.0 ||
+                 b.expected > 0.0;
+  if (limited && !within(static_cost(*m_root), b)) {
+    if (m_opts.action == budget_action::REJECT) {
+      m_root.reset();
+      throw nexcept("[nforce] expression over cost budget",
+                    status_type::OVER_BUDGET);
+    }
+    m_status = status_type::OVER_BUDGET;
+  }
   return std::move(m_root);
 }
 } // namespace n4
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "nforce/prefilter.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+using cnf = std::vector<prefilter::clause>;
+
+std::size_t skip_class(const std::string &pattern, std::size_t pos) {
+  // pos is on '[', a leading ']' (or '^]') is part of the class
+  ++pos;
+  if (pos < pattern.size() && pattern[pos] == '^') {
+    ++pos;
+  }
+  if (pos < pattern.size() && pattern[pos] == ']') {
+    ++pos;
+  }
+  for (; pos < pattern.size() && pattern[pos] != ']'; ++pos) {
+    if (pattern[pos] == '\\') {
+      ++pos;
+    }
+  }
+  return pos;
+}
+
+std::size_t skip_escape(const std::string &pattern, std::size_t pos) {
+  // pos is on the letter or digit following '\', returns the position of
+  // the last character of the escape: operands of \xHH, \uHHHH and \cX,
+  // digits of \0 and of back references
+  auto next_is = [&](int (*is)(int)) {
+    return pos + 1 < pattern.size() &&
+           is(static_cast<unsigned char>(pattern[pos + 1]));
+  };
+
+  switch (pattern[pos]) {
+  case 'x':
+  case 'u':
+    for (int n = (pattern[pos] == 'x') ? 2 : 4; n && next_is(std::isxdigit);
+         --n) {
+      ++pos;
+    }
+    break;
+  case 'c':
+    if (next_is(std::isalpha)) {
+      ++pos;
+    }
+    break;
+  default:
+    if (std::isdigit(static_cast<unsigned char>(pattern[pos]))) {
+      while (next_is(std::isdigit)) {
+        ++pos;
+      }
+    }
+    break;
+  }
+  return pos;
+}
+
+std::size_t skip_group(const std::string &pattern, std::size_t pos) {
+  // pos is on '(', returns the position of the matching ')'
+  std::size_t depth = 0;
+  for (; pos < pattern.size(); ++pos) {
+    switch (pattern[pos]) {
+    case '\\':
+      ++pos;
+      break;
+    case '[':
+      pos = skip_class(pattern, pos);
+      break;
+    case '(':
+      ++depth;
+      break;
+    case ')':
+      if (--depth == 0) {
+        return pos;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  return pos;
+}
+} // namespace
+
+class literal_analyzer final : public expr_visitor {
+public:
+  literal_analyzer(const literal_hint &hint, const prefilter_options &opts)
+      : m_hint{hint}, m_opts{opts} {}
+
+  cnf analyze(const expr *e, bool positive) {
+    if (!e) {
+      throw nexcept("[nforce] missing operand", status_type::BAD_AST);
+    }
+
+    auto saved = m_positive;
+    m_positive = positive;
+    e->accept(*this);
+    m_positive = saved;
+    return std::move(m_result);
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::OR> &e) override {
+    this->combine({e.left_op(), e.right_op()}, !m_positive);
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::AND> &e) override {
+    this->combine({e.left_op(), e.right_op()}, m_positive);
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::OR> &e) override {
+    this->combine(this->operands(e), !m_positive);
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::AND> &e) override {
+    this->combine(this->operands(e), m_positive);
+  }
+
+  void visit(const unary_not_expr &e) override {
+    m_result = this->analyze(e.op(), !m_positive);
+  }
+
+  void visit(const rule_expr &e) override {
+    // a leaf being false says nothing about the record
+    m_result.clear();
+    if (!m_positive || !m_hint) {
+      return;
+    }
+
+    for (auto &lit : m_hint(e)) {
+      if (!lit.empty()) {
+        m_result.push_back({std::move(lit)});
+      }
+    }
+    this->normalize(m_result);
+  }
+
+private:
+  template <binary_op_type Op>
+  std::vector<const expr *> operands(const nary_gen_expr<Op> &e) const {
+    if (e.size() == 0) {
+      throw nexcept("[nforce] empty n-ary expression", status_type::BAD_AST);
+    }
+
+    std::vector<const expr *> ops;
+    for (std::size_t i = 0; i < e.size(); ++i) {
+      ops.push_back(e.op(i));
+    }
+    return ops;
+  }
+
+  // operands are analyzed with the current polarity, a negated AND being
+  // an OR of the negated operands and conversely
+  void combine(const std::vector<const expr *> &ops, bool conjunction) {
+    cnf acc;
+    for (std::size_t i = 0; i < ops.size(); ++i) {
+      auto next = this->analyze(ops[i], m_positive);
+      if (i == 0) {
+        acc = std::move(next);
+      } else if (conjunction) {
+        acc.insert(acc.end(), std::make_move_iterator(next.begin()),
+                   std::make_move_iterator(next.end()));
+      } else {
+        acc = this->cross(acc, next);
+      }
+      this->normalize(acc);
+    }
+    m_result = std::move(acc);
+  }
+
+  // (a1 & a2) | (b1 & b2) implies (a1 | b1) & (a1 | b2) & ...
+  cnf cross(const cnf &a, const cnf &b) const {
+    cnf out;
+    for (const auto &ca : a) {
+      for (const auto &cb : b) {
+        if (ca.size() + cb.size() > 2 * m_opts.max_width) {
+          continue;
+        }
+        auto c = ca;
+        c.insert(c.end(), cb.begin(), cb.end());
+        out.push_back(std::move(c));
+      }
+    }
+    return out;
+  }
+
+  void normalize(cnf &clauses) const {
+    for (auto &c : clauses) {
+      std::sort(c.begin(), c.end());
+      c.erase(std::unique(c.begin(), c.end()), c.end());
+    }
+
+    clauses.erase(std::remove_if(clauses.begin(), clauses.end(),
+                                 [this](const auto &c) {
+                                   return c.size() > m_opts.max_width;
+                                 }),
+                  clauses.end());
+
+    // narrow clauses first, they are the most selective ones
+    std::sort(clauses.begin(), clauses.end(),
+              [](const auto &c1, const auto &c2) {
+                return c1.size() != c2.size() ? c1.size() < c2.size()
+                                              : c1 < c2;
+              });
+
+    // drop clauses implied by a narrower one
+    cnf kept;
+    for (auto &c : clauses) {
+      auto implied = std::any_of(kept.begin(), kept.end(), [&](const auto &k) {
+        return std::includes(c.begin(), c.end(), k.begin(), k.end());
+      });
+      if (!implied) {
+        kept.push_back(std::move(c));
+      }
+    }
+
+    if (kept.size() > m_opts.max_clauses) {
+      kept.resize(m_opts.max_clauses);
+    }
+    clauses = std::move(kept);
+  }
+
+  const literal_hint &m_hint;
+  const prefilter_options &m_opts;
+  bool m_positive{true};
+  cnf m_result;
+};
+
+prefilter::signature prefilter::sign(std::string_view str) {
+  signature sig{};
+  for (std::size_t i = 1; i < str.size(); ++i) {
+    auto bit = (static_cast<unsigned char>(str[i - 1]) * 31u +
+                static_cast<unsigned char>(str[i])) &
+               255u;
+    sig[bit >> 6] |= std::uint64_t{1} << (bit & 63u);
+  }
+  return sig;
+}
+
+//-------------------------------------
+// Public
+
+prefilter::prefilter(const expr &root, const literal_hint &hint,
+                     const prefilter_options &opts) {
+  literal_analyzer analyzer{hint, opts};
+  m_clauses = analyzer.analyze(&root, true);
+
+  for (const auto &c : m_clauses) {
+    std::vector<needle> needles;
+    for (const auto &lit : c) {
+      needles.push_back({lit, prefilter::sign(lit)});
+    }
+    m_needles.push_back(std::move(needles));
+  }
+}
+
+bool prefilter::may_match(std::string_view record) const {
+  if (m_needles.empty()) {
+    return true;
+  }
+
+  auto sig = prefilter::sign(record);
+  auto present = [&](const needle &n) {
+    for (std::size_t w = 0; w < sig.size(); ++w) {
+      if (n.sig[w] & ~sig[w]) {
+        return false;
+      }
+    }
+    return record.find(n.text) != std::string_view::npos;
+  };
+
+  return std::all_of(m_needles.begin(), m_needles.end(),
+                     [&](const auto &needles) {
+                       return std::any_of(needles.begin(), needles.end(),
+                                          present);
+                     });
+}
+
+std::vector<std::string> regex_literals(const std::string &pattern) {
+  std::vector<std::string> out;
+  std::string run;
+  bool last_literal = false;
+
+  auto flush = [&] {
+    if (!run.empty() &&
+        std::find(out.begin(), out.end(), run) == out.end()) {
+      out.push_back(run);
+    }
+    run.clear();
+    last_literal = false;
+  };
+
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    auto c = pattern[i];
+    switch (c) {
+    case '|':
+      // groups are skipped, any alternative seen here is a top level one
+      return {};
+    case '(':
+      flush();
+      i = skip_group(pattern, i);
+      break;
+    case '[':
+      flush();
+      i = skip_class(pattern, i);
+      break;
+    case '.':
+    case '^':
+    case '$':
+      flush();
+      break;
+    case '*':
+    case '?':
+    case '{':
+    case '+':
+      // the quantified character is only required by '+' and ends the run
+      if (last_literal && c != '+') {
+        run.pop_back();
+      }
+      flush();
+      if (c == '{') {
+        i = pattern.find('}', i);
+        if (i == std::string::npos) {
+          return {};
+        }
+      }
+      if (i + 1 < pattern.size() && pattern[i + 1] == '?') {
+        ++i;
+      }
+      break;
+    case '\\':
+      if (++i == pattern.size()) {
+        return {};
+      }
+      if (std::isalnum(static_cast<unsigned char>(pattern[i]))) {
+        // character classes, assertions, back references and escapes,
+        // none of which (nor their operands) is literal text
+        flush();
+        i = skip_escape(pattern, i);
+      } else {
+        run += pattern[i];
+        last_literal = true;
+      }
+      break;
+    default:
+      run += c;
+      last_literal = true;
+      break;
+    }
+  }
+  flush();
+  return out;
+}
+} // namespace n4
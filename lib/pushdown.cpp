@@ -0,0 +1,237 @@
+#include "nforce/pushdown.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/leaves.h"
+
+#include <cstdint>
+#include <memory>
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+using bits = std::vector<std::uint64_t>;
+
+bits make_bits(std::size_t count, bool value) {
+  bits b((count + 63) / 64, value ? ~std::uint64_t{0} : 0);
+  if (value && (count & 63)) {
+    b.back() = (std::uint64_t{1} << (count & 63)) - 1;
+  }
+  return b;
+}
+
+bool test(const bits &b, std::size_t i) { return (b[i >> 6] >> (i & 63)) & 1u; }
+} // namespace
+
+class pushdown_planner final : public expr_visitor {
+public:
+  // records that surely match, that may match and the expression deciding
+  // in between
+  struct plan {
+    bits lower;
+    bits upper;
+    std::unique_ptr<expr> residual;
+  };
+
+  pushdown_planner(const leaf_set &leaves, record_source &source,
+                   const std::size_t &current)
+      : m_leaves{leaves}, m_count{source.size()}, m_current{current} {
+    for (std::size_t i = 0; i < leaves.size(); ++i) {
+      auto p = source.push(leaves[i]);
+
+      leaf_plan entry{p.type, nullptr};
+      if (p.type != pushdown_type::NONE) {
+        auto b = std::make_shared<bits>(make_bits(m_count, false));
+        for (auto r : p.records) {
+          if (r >= m_count) {
+            throw nexcept("[nforce] pushed record out of range",
+                          status_type::INTERNAL_ERROR);
+          }
+          (*b)[r >> 6] |= std::uint64_t{1} << (r & 63);
+        }
+        entry.records = std::move(b);
+        ++m_pushed;
+      }
+      m_pushed_leaves.push_back(std::move(entry));
+    }
+  }
+
+  std::size_t pushed() const { return m_pushed; }
+
+  plan build(const expr *e) {
+    if (!e) {
+      throw nexcept("[nforce] missing operand", status_type::BAD_AST);
+    }
+    e->accept(*this);
+    return std::move(m_result);
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::OR> &e) override {
+    this->combine<binary_op_type::OR>({e.left_op(), e.right_op()});
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::AND> &e) override {
+    this->combine<binary_op_type::AND>({e.left_op(), e.right_op()});
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::OR> &e) override {
+    this->combine<binary_op_type::OR>(this->operands(e));
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::AND> &e) override {
+    this->combine<binary_op_type::AND>(this->operands(e));
+  }
+
+  void visit(const unary_not_expr &e) override {
+    auto p = this->build(e.op());
+
+    // sure matches of the negation are the records that cannot match
+    for (std::size_t w = 0; w < p.lower.size(); ++w) {
+      auto lower = p.lower[w];
+      p.lower[w] = ~p.upper[w];
+      p.upper[w] = ~lower;
+    }
+    if (m_count & 63) {
+      auto mask = (std::uint64_t{1} << (m_count & 63)) - 1;
+      p.lower.back() &= mask;
+      p.upper.back() &= mask;
+    }
+
+    auto n = std::make_unique<unary_not_expr>();
+    n->set_op(std::move(p.residual));
+    m_result = {std::move(p.lower), std::move(p.upper), std::move(n)};
+  }
+
+  void visit(const rule_expr &e) override {
+    const auto &p = m_pushed_leaves[m_leaves.index_of(e)];
+    const auto &current = m_current;
+    auto records = p.records;
+
+    switch (p.type) {
+    case pushdown_type::EXACT:
+      m_result = {*records, *records,
+                  std::make_unique<rule_expr>(
+                      [records, &current] { return test(*records, current); },
+                      e.rule())};
+      break;
+    case pushdown_type::RESTRICT:
+      m_result = {make_bits(m_count, false), *records,
+                  std::make_unique<rule_expr>(
+                      [records, &current, &e] {
+                        return test(*records, current) && e.interpret();
+                      },
+                      e.rule(), e.cost())};
+      break;
+    default:
+      m_result = {make_bits(m_count, false), make_bits(m_count, true),
+                  std::make_unique<rule_expr>([&e] { return e.interpret(); },
+                                              e.rule(), e.cost())};
+      break;
+    }
+  }
+
+private:
+  struct leaf_plan {
+    pushdown_type type;
+    std::shared_ptr<const bits> records;
+  };
+
+  template <binary_op_type Op>
+  std::vector<const expr *> operands(const nary_gen_expr<Op> &e) const {
+    if (e.size() == 0) {
+      throw nexcept("[nforce] empty n-ary expression", status_type::BAD_AST);
+    }
+
+    std::vector<const expr *> ops;
+    for (std::size_t i = 0; i < e.size(); ++i) {
+      ops.push_back(e.op(i));
+    }
+    return ops;
+  }
+
+  template <binary_op_type Op>
+  void combine(const std::vector<const expr *> &ops) {
+    auto acc = this->build(ops.front());
+
+    std::unique_ptr<expr> residual;
+    if (ops.size() == 2) {
+      auto b = std::make_unique<binary_gen_expr<Op>>();
+      b->set_left_op(std::move(acc.residual));
+      auto next = this->build(ops.back());
+      this->merge<Op>(acc, next);
+      b->set_right_op(std::move(next.residual));
+      residual = std::move(b);
+    } else {
+      auto n = std::make_unique<nary_gen_expr<Op>>();
+      n->add_op(std::move(acc.residual));
+      for (std::size_t i = 1; i < ops.size(); ++i) {
+        auto next = this->build(ops[i]);
+        this->merge<Op>(acc, next);
+        n->add_op(std::move(next.residual));
+      }
+      residual = std::move(n);
+    }
+
+    acc.residual = std::move(residual);
+    m_result = std::move(acc);
+  }
+
+  template <binary_op_type Op> void merge(plan &acc, const plan &next) {
+    for (std::size_t w = 0; w < acc.lower.size(); ++w) {
+      if constexpr (Op == binary_op_type::AND) {
+        acc.lower[w] &= next.lower[w];
+        acc.upper[w] &= next.upper[w];
+      } else {
+        acc.lower[w] |= next.lower[w];
+        acc.upper[w] |= next.upper[w];
+      }
+    }
+  }
+
+  const leaf_set &m_leaves;
+  std::size_t m_count;
+  const std::size_t &m_current;
+  std::vector<leaf_plan> m_pushed_leaves;
+  std::size_t m_pushed{0};
+  plan m_result;
+};
+
+//-------------------------------------
+// Public
+
+pushdown_result pushdown_filter(const expr &root, record_source &source) {
+  leaf_set leaves{root};
+
+  std::size_t current = 0;
+  pushdown_planner planner{leaves, source, current};
+  auto p = planner.build(&root);
+
+  pushdown_result res;
+  res.pushed = planner.pushed();
+
+  // records outside the upper bound are never loaded
+  const auto count = source.size();
+  for (std::size_t i = 0; i < count; ++i) {
+    if (!p.upper[i >> 6]) {
+      i |= 63;
+      continue;
+    }
+    if (!test(p.upper, i)) {
+      continue;
+    }
+
+    if (!test(p.lower, i)) {
+      current = i;
+      source.load(i);
+      ++res.loaded;
+      if (!p.residual->interpret()) {
+        continue;
+      }
+    }
+    res.matches.push_back(i);
+  }
+
+  return res;
+}
+} // namespace n4
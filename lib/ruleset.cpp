@@ -0,0 +1,243 @@
+#include "nforce/ruleset.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/lexer.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+std::size_t ruleset::shard_of(const std::string &name) {
+  return std::hash<std::string>{}(name) % shard_count;
+}
+
+std::unique_ptr<expr> ruleset::build(const std::string &text) {
+  // checkers consult the leaf cache first so that leaves already resolved
+  // by a previous build skip the (potentially expensive) checker scan, and
+  // leaves are compiled through the cache, lazily if requested
+  std::vector<parser::rule_handler> handlers;
+  handlers.reserve(m_handlers.size());
+  for (std::size_t i = 0; i < m_handlers.size(); ++i) {
+    handlers.emplace_back(
+        [this, i](const std::string &str) {
+          if (auto hit = m_leaves.find(str); hit != m_leaves.end()) {
+            return hit->second.owner == i;
+          }
+          if (!m_handlers[i].first(str)) {
+            return false;
+          }
+          m_leaves.emplace(str, cached_leaf{i, {}});
+          return true;
+        },
+        parser::compiler_cb{[this, i](const std::string &str) {
+          return this->leaf(i, str);
+        }},
+        m_handlers[i].cost);
+  }
+
+  auto opts = m_opts;
+  opts.lazy = false;
+
+  lexer lex{text};
+  parser p{lex, std::move(handlers), opts};
+  return p.build();
+}
+
+rule_expr::interpretor ruleset::leaf(std::size_t owner,
+                                     const std::string &text) {
+  auto &cached = m_leaves[text];
+  auto interp = cached.interpretor.lock();
+  if (!interp) {
+    interp = std::make_shared<const rule_expr::interpretor>(
+        parser::interpretor_of(m_handlers[owner], text, m_opts.lazy));
+    cached = cached_leaf{owner, interp};
+  }
+  return [interp] { return (*interp)(); };
+}
+
+void ruleset::publish(std::unique_ptr<version> next) {
+  next->m_id = m_epoch.load() + 1;
+  const auto *old = m_current.exchange(next.release());
+
+  // the epoch moves after the swap so that a reader entering with the new
+  // epoch is guaranteed to load the new version
+  auto retire = ++m_epoch;
+  if (old) {
+    m_retired.emplace_back(retire, std::unique_ptr<const version>{old});
+  }
+  this->collect();
+}
+
+std::size_t ruleset::collect() {
+  auto oldest = idle;
+  {
+    std::lock_guard<std::mutex> lock{m_slots_mutex};
+    for (const auto &s : m_slots) {
+      oldest = std::min(oldest, s->epoch.load());
+    }
+  }
+
+  // a reader entered at epoch e may hold any version retired after e
+  m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(),
+                                 [oldest](const auto &r) {
+                                   return r.first <= oldest;
+                                 }),
+                  m_retired.end());
+
+  // leaves only referenced by freed versions, or by failed builds
+  for (auto it = m_leaves.begin(); it != m_leaves.end();) {
+    it = it->second.interpretor.expired() ? m_leaves.erase(it) : std::next(it);
+  }
+  return m_retired.size();
+}
+
+std::size_t ruleset::update_locked(const std::vector<change> &changes) {
+  const auto &curr = *m_current.load();
+
+  auto next = std::make_unique<version>();
+  next->m_shards = curr.m_shards;
+  next->m_size = curr.m_size;
+
+  // untouched shards stay shared, a touched shard is copied once
+  std::vector<std::shared_ptr<version::shard>> touched(shard_count);
+  std::size_t rebuilt = 0;
+  bool dirty = false;
+
+  for (const auto &[name, text] : changes) {
+    auto index = ruleset::shard_of(name);
+    if (!touched[index]) {
+      touched[index] =
+          std::make_shared<version::shard>(*curr.m_shards[index]);
+      next->m_shards[index] = touched[index];
+    }
+    auto &s = *touched[index];
+
+    if (!text) {
+      auto erased = s.erase(name);
+      next->m_size -= erased;
+      dirty = dirty || erased != 0;
+      continue;
+    }
+
+    auto it = s.find(name);
+    if (it != s.end() && it->second->text == *text) {
+      continue;
+    }
+
+    auto r = std::make_shared<rule>();
+    r->text = *text;
+    r->expression = this->build(*text);
+    ++rebuilt;
+    dirty = true;
+
+    if (it == s.end()) {
+      s.emplace(name, std::move(r));
+      ++next->m_size;
+    } else {
+      it->second = std::move(r);
+    }
+  }
+
+  if (dirty) {
+    this->publish(std::move(next));
+  }
+  return rebuilt;
+}
+
+//-------------------------------------
+// Public
+
+const ruleset::rule *ruleset::version::find(const std::string &name) const {
+  const auto &s = *m_shards[ruleset::shard_of(name)];
+  auto it = s.find(name);
+  return it != s.end() ? it->second.get() : nullptr;
+}
+
+ruleset::read_guard::read_guard(read_guard &&other) noexcept
+    : m_version{other.m_version}, m_epoch{other.m_epoch} {
+  other.m_epoch = nullptr;
+}
+
+ruleset::read_guard::~read_guard() {
+  if (m_epoch) {
+    m_epoch->store(idle);
+  }
+}
+
+ruleset::reader::reader(ruleset &rs) : m_rs{rs} {
+  std::lock_guard<std::mutex> lock{m_rs.m_slots_mutex};
+  auto it = std::find_if(m_rs.m_slots.begin(), m_rs.m_slots.end(),
+                         [](const auto &s) { return !s->used; });
+  if (it == m_rs.m_slots.end()) {
+    it = m_rs.m_slots.insert(it, std::make_unique<slot>());
+  }
+  (*it)->used = true;
+  m_slot = static_cast<std::size_t>(it - m_rs.m_slots.begin());
+  // slots are never freed, the epoch stays valid without the lock
+  m_epoch = &(*it)->epoch;
+}
+
+ruleset::reader::~reader() {
+  std::lock_guard<std::mutex> lock{m_rs.m_slots_mutex};
+  m_rs.m_slots[m_slot]->used = false;
+}
+
+ruleset::read_guard ruleset::reader::read() {
+  m_epoch->store(m_rs.m_epoch.load());
+  return read_guard{m_rs.m_current.load(), m_epoch};
+}
+
+ruleset::ruleset(std::vector<parser::rule_handler> &&handlerList,
+                 const parser_options &opts)
+    : m_handlers{std::move(handlerList)}, m_opts{opts} {
+  auto empty = std::make_shared<version::shard>();
+  auto v = std::make_unique<version>();
+  v->m_shards.assign(shard_count, empty);
+  this->publish(std::move(v));
+}
+
+ruleset::~ruleset() { delete m_current.load(); }
+
+std::size_t
+ruleset::reload(const std::unordered_map<std::string, std::string> &rules) {
+  // the diff is applied under the same lock so that no concurrent update
+  // slips in between
+  std::lock_guard<std::mutex> lock{m_writer};
+  const auto &curr = *m_current.load();
+
+  std::vector<change> changes;
+  for (const auto &[name, text] : rules) {
+    const auto *r = curr.find(name);
+    if (!r || r->text != text) {
+      changes.emplace_back(name, text);
+    }
+  }
+
+  for (const auto &s : curr.m_shards) {
+    for (const auto &entry : *s) {
+      if (rules.find(entry.first) == rules.end()) {
+        changes.emplace_back(entry.first, std::nullopt);
+      }
+    }
+  }
+  return this->update_locked(changes);
+}
+
+std::size_t ruleset::update(const std::vector<change> &changes) {
+  std::lock_guard<std::mutex> lock{m_writer};
+  return this->update_locked(changes);
+}
+
+std::size_t ruleset::cached_leaves() {
+  std::lock_guard<std::mutex> lock{m_writer};
+  return m_leaves.size();
+}
+
+std::size_t ruleset::reclaim() {
+  std::lock_guard<std::mutex> lock{m_writer};
+  return this->collect();
+}
+} // namespace n4
@@ -0,0 +1,147 @@
+#include "nforce/specialize.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+
+#include <vector>
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+class residual_builder final : public expr_visitor {
+public:
+  // a folded subtree is either a constant or a residual expression
+  struct part {
+    std::optional<bool> value;
+    std::unique_ptr<expr> residual;
+  };
+
+  explicit residual_builder(const leaf_oracle &oracle) : m_oracle{oracle} {}
+
+  part fold(const expr *e) {
+    if (!e) {
+      throw nexcept("[nforce] missing operand", status_type::BAD_AST);
+    }
+    e->accept(*this);
+    return std::move(m_result);
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::OR> &e) override {
+    this->combine<binary_op_type::OR>({e.left_op(), e.right_op()});
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::AND> &e) override {
+    this->combine<binary_op_type::AND>({e.left_op(), e.right_op()});
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::OR> &e) override {
+    this->combine<binary_op_type::OR>(this->operands(e));
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::AND> &e) override {
+    this->combine<binary_op_type::AND>(this->operands(e));
+  }
+
+  void visit(const unary_not_expr &e) override {
+    auto p = this->fold(e.op());
+    if (p.value) {
+      m_result = {!*p.value, nullptr};
+      return;
+    }
+
+    auto n = std::make_unique<unary_not_expr>();
+    n->set_op(std::move(p.residual));
+    m_result = {std::nullopt, std::move(n)};
+  }
+
+  void visit(const rule_expr &e) override {
+    if (auto value = m_oracle(e)) {
+      m_result = {*value, nullptr};
+      return;
+    }
+
+    // the residual leaf keeps the rule text and cost so that it is still
+    // identified and costed as the same leaf by expression analysis
+    m_result = {std::nullopt,
+                std::make_unique<rule_expr>([&e] { return e.interpret(); },
+                                            e.rule(), e.cost())};
+  }
+
+private:
+  template <binary_op_type Op>
+  std::vector<const expr *> operands(const nary_gen_expr<Op> &e) const {
+    if (e.size() == 0) {
+      throw nexcept("[nforce] empty n-ary expression", status_type::BAD_AST);
+    }
+
+    std::vector<const expr *> ops;
+    for (std::size_t i = 0; i < e.size(); ++i) {
+      ops.push_back(e.op(i));
+    }
+    return ops;
+  }
+
+  template <binary_op_type Op>
+  void combine(const std::vector<const expr *> &ops) {
+    // absorbing value of the operator, true for OR and false for AND
+    constexpr bool absorbing = (Op == binary_op_type::OR);
+
+    std::vector<std::unique_ptr<expr>> kept;
+    for (const auto *op : ops) {
+      auto p = this->fold(op);
+      if (!p.value) {
+        kept.push_back(std::move(p.residual));
+      } else if (*p.value == absorbing) {
+        m_result = {absorbing, nullptr};
+        return;
+      }
+    }
+
+    if (kept.empty()) {
+      m_result = {!absorbing, nullptr};
+    } else if (kept.size() == 1) {
+      m_result = {std::nullopt, std::move(kept.front())};
+    } else if (kept.size() == 2) {
+      auto b = std::make_unique<binary_gen_expr<Op>>();
+      b->set_left_op(std::move(kept[0]));
+      b->set_right_op(std::move(kept[1]));
+      m_result = {std::nullopt, std::move(b)};
+    } else {
+      auto n = std::make_unique<nary_gen_expr<Op>>();
+      for (auto &k : kept) {
+        n->add_op(std::move(k));
+      }
+      m_result = {std::nullopt, std::move(n)};
+    }
+  }
+
+  const leaf_oracle &m_oracle;
+  part m_result;
+};
+} // namespace
+
+
+//-------------------------------------
+// Public
+
+std::unique_ptr<expr> specialize(const expr &root, const leaf_oracle &oracle) {
+  residual_builder builder{oracle};
+  auto p = builder.fold(&root);
+  if (p.value) {
+    return std::make_unique<rule_expr>([v = *p.value] { return v; });
+  }
+  return std::move(p.residual);
+}
+
+std::unique_ptr<expr>
+specialize(const expr &root,
+           const std::unordered_map<std::string, bool> &known) {
+  return specialize(root, [&known](const rule_expr &e) -> std::optional<bool> {
+    if (auto hit = known.find(e.rule()); hit != known.end()) {
+      return hit->second;
+    }
+    return std::nullopt;
+  });
+}
+} // namespace n4
@@ -0,0 +1,274 @@
+#include "nforce/speculative.h"
+#include "nforce/core/except.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+enum operand_status : int {
+  op_pending = 0,
+  op_running,
+  op_false,
+  op_true,
+  op_failed,
+  op_skipped
+};
+
+// operands of a node being evaluated concurrently, shared with the pool
+// tasks that may only start once the node is done
+struct race {
+  race(std::size_t count, int d, const race *p)
+      : status(count), errors(count), deciding{d}, parent{p} {}
+
+  bool cancelled() const {
+    for (auto r = this; r; r = r->parent) {
+      if (r->stop.load()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<std::atomic<int>> status;
+  std::vector<std::exception_ptr> errors;
+  std::atomic<bool> stop{false};
+  // operand result deciding the node
+  int deciding;
+  // only read while an operand of this race runs, its parent is then alive
+  const race *parent;
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+thread_local const race *t_race = nullptr;
+
+void run_operand(race &r, std::size_t i, const expr *op) {
+  int expected = op_pending;
+  if (!r.status[i].compare_exchange_strong(expected, op_running)) {
+    return;
+  }
+
+  int result = op_skipped;
+  if (!r.cancelled()) {
+    auto saved = std::exchange(t_race, &r);
+    try {
+      result = op->interpret() ? op_true : op_false;
+    } catch (...) {
+      r.errors[i] = std::current_exception();
+      result = op_failed;
+    }
+    t_race = saved;
+  }
+
+  // the deciding operand stops its siblings, whichever thread runs them
+  if (result == r.deciding) {
+    r.stop = true;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{r.mutex};
+    r.status[i].store(result);
+  }
+  r.cv.notify_all();
+}
+
+///
+/// AND/OR node whose operands race on a pool, visitors see the n-ary node
+/// it wraps
+///
+template <binary_op_type Op> class parallel_gen_expr final : public expr {
+public:
+  parallel_gen_expr(std::unique_ptr<nary_gen_expr<Op>> ops, executor &pool)
+      : m_ops{std::move(ops)}, m_pool{pool} {}
+
+  bool interpret() const override {
+    if (m_pool.load() >= m_pool.size()) {
+      return m_ops->interpret();
+    }
+
+    const auto count = m_ops->size();
+    auto r = std::make_shared<race>(count, deciding, t_race);
+    for (std::size_t i = 1; i < count; ++i) {
+      m_pool.submit([r, i, op = m_ops->op(i)](std::size_t) {
+        run_operand(*r, i, op);
+      });
+    }
+
+    // the calling thread takes the operands no worker has started yet
+    for (std::size_t i = 0; i < count && !this->decided(*r); ++i) {
+      run_operand(*r, i, m_ops->op(i));
+    }
+
+    std::unique_lock<std::mutex> lock{r->mutex};
+    r->cv.wait(lock, [&] { return this->decided(*r); });
+
+    r->stop = true;
+    for (auto &s : r->status) {
+      int expected = op_pending;
+      s.compare_exchange_strong(expected, op_skipped);
+    }
+    r->cv.wait(lock, [&] {
+      for (const auto &s : r->status) {
+        if (s.load() == op_running) {
+          return false;
+        }
+      }
+      return true;
+    });
+
+    return this->result(*r);
+  }
+
+  void accept(expr_visitor &v) const override { m_ops->accept(v); }
+
+private:
+  // AND is decided by a false operand, OR by a true one
+  static constexpr int deciding =
+      (Op == binary_op_type::OR) ? op_true : op_false;
+
+  bool decided(const race &r) const {
+    bool finished = true;
+    for (const auto &s : r.status) {
+      auto v = s.load();
+      if (v == deciding) {
+        return true;
+      }
+      finished = finished && v != op_pending && v != op_running;
+    }
+    return finished;
+  }
+
+  bool result(const race &r) const {
+    for (const auto &s : r.status) {
+      if (s.load() == deciding) {
+        return deciding == op_true;
+      }
+    }
+
+    for (const auto &e : r.errors) {
+      if (e) {
+        std::rethrow_exception(e);
+      }
+    }
+
+    // a skipped operand means an enclosing node is cancelled, its result
+    // is ignored
+    return deciding != op_true;
+  }
+
+  std::unique_ptr<nary_gen_expr<Op>> m_ops;
+  executor &m_pool;
+};
+} // namespace
+
+class speculative_builder final {
+public:
+  speculative_builder(speculative_expr &target, executor &pool,
+                      const expensive_hint &hint)
+      : m_target{target}, m_pool{pool}, m_hint{hint} {}
+
+  // rebuilt node and whether it holds an expensive leaf
+  std::pair<std::unique_ptr<expr>, bool> build(std::unique_ptr<expr> e) {
+    if (!e) {
+      throw nexcept("[nforce] missing operand", status_type::BAD_AST);
+    }
+
+    using and_expr = binary_gen_expr<binary_op_type::AND>;
+    using or_expr = binary_gen_expr<binary_op_type::OR>;
+
+    if (auto b = dynamic_cast<and_expr *>(e.get())) {
+      return this->chain<binary_op_type::AND>(std::move(e), this->operands(*b));
+    }
+    if (auto b = dynamic_cast<or_expr *>(e.get())) {
+      return this->chain<binary_op_type::OR>(std::move(e), this->operands(*b));
+    }
+    if (auto n = dynamic_cast<all_of_expr *>(e.get())) {
+      return this->chain<binary_op_type::AND>(std::move(e), n->release_ops());
+    }
+    if (auto n = dynamic_cast<any_of_expr *>(e.get())) {
+      return this->chain<binary_op_type::OR>(std::move(e), n->release_ops());
+    }
+    if (auto u = dynamic_cast<unary_not_expr *>(e.get())) {
+      auto [op, expensive] = this->build(u->release_op());
+      u->set_op(std::move(op));
+      return {std::move(e), expensive};
+    }
+    if (auto r = dynamic_cast<rule_expr *>(e.get())) {
+      auto expensive = m_hint && m_hint(*r);
+      return {std::move(e), expensive};
+    }
+
+    // other nodes are kept as they are
+    return {std::move(e), false};
+  }
+
+private:
+  template <binary_op_type Op>
+  std::vector<std::unique_ptr<expr>> operands(binary_gen_expr<Op> &b) {
+    std::vector<std::unique_ptr<expr>> ops;
+    ops.push_back(b.release_left_op());
+    ops.push_back(b.release_right_op());
+    return ops;
+  }
+
+  template <binary_op_type Op>
+  std::pair<std::unique_ptr<expr>, bool>
+  chain(std::unique_ptr<expr> node, std::vector<std::unique_ptr<expr>> ops) {
+    if (ops.empty()) {
+      throw nexcept("[nforce] empty n-ary expression", status_type::BAD_AST);
+    }
+
+    std::size_t expensive = 0;
+    for (auto &op : ops) {
+      auto built = this->build(std::move(op));
+      op = std::move(built.first);
+      expensive += built.second;
+    }
+
+    if (expensive < 2) {
+      // put operands back in place
+      if (auto b = dynamic_cast<binary_gen_expr<Op> *>(node.get())) {
+        b->set_left_op(std::move(ops[0]));
+        b->set_right_op(std::move(ops[1]));
+      } else {
+        auto n = static_cast<nary_gen_expr<Op> *>(node.get());
+        for (auto &op : ops) {
+          n->add_op(std::move(op));
+        }
+      }
+      return {std::move(node), expensive != 0};
+    }
+
+    auto n = std::make_unique<nary_gen_expr<Op>>();
+    for (auto &op : ops) {
+      n->add_op(std::move(op));
+    }
+    ++m_target.m_parallel;
+    return {std::make_unique<parallel_gen_expr<Op>>(std::move(n), m_pool),
+            true};
+  }
+
+  speculative_expr &m_target;
+  executor &m_pool;
+  const expensive_hint &m_hint;
+};
+
+//-------------------------------------
+// Public
+
+speculative_expr::speculative_expr(std::unique_ptr<expr> root, executor &pool,
+                                   const expensive_hint &hint) {
+  speculative_builder builder{*this, pool, hint};
+  m_root = builder.build(std::move(root)).first;
+}
+
+bool cancellation_requested() { return t_race && t_race->cancelled(); }
+} // namespace n4
@@ -0,0 +1,196 @@
+#include "nforce/trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+std::atomic<bool> g_enabled{false};
+std::atomic<std::uint64_t> g_expr_ids{0};
+thread_local std::uint64_t t_expr{0};
+
+std::uint64_t now() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// single producer (the owning thread) single consumer (drain, serialized
+// by the registry lock) ring of spans
+class trace_ring final {
+public:
+  static constexpr std::uint64_t capacity = 4096;
+
+  explicit trace_ring(std::uint32_t thread)
+      : m_events(capacity), m_thread{thread} {}
+
+  std::uint32_t thread() const { return m_thread; }
+
+  void push(const trace_event &e) {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) == capacity) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    m_events[head % capacity] = e;
+    m_head.store(head + 1, std::memory_order_release);
+  }
+
+  void drain(std::vector<trace_event> &out) {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    auto head = m_head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      out.push_back(m_events[tail % capacity]);
+    }
+    m_tail.store(head, std::memory_order_release);
+  }
+
+  std::uint64_t dropped() const {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::vector<trace_event> m_events;
+  std::uint32_t m_thread;
+  std::atomic<std::uint64_t> m_head{0};
+  std::atomic<std::uint64_t> m_tail{0};
+  std::atomic<std::uint64_t> m_dropped{0};
+};
+
+// rings outlive their threads so that spans of finished threads can still
+// be drained
+struct trace_registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<trace_ring>> rings;
+};
+
+trace_registry &registry() {
+  static trace_registry r;
+  return r;
+}
+
+trace_ring &local_ring() {
+  thread_local std::shared_ptr<trace_ring> ring = [] {
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock{r.mutex};
+    auto res = std::make_shared<trace_ring>(
+        static_cast<std::uint32_t>(r.rings.size()));
+    r.rings.push_back(res);
+    return res;
+  }();
+  return *ring;
+}
+
+const char *phase_name(trace_phase p) {
+  switch (p) {
+  case trace_phase::LEX:
+    return "lex";
+  case trace_phase::MATCH:
+    return "match";
+  case trace_phase::BUILD:
+    return "build";
+  case trace_phase::INTERPRET:
+    return "interpret";
+  }
+  return "unknown";
+}
+} // namespace
+
+//-------------------------------------
+// Public
+
+bool tracing_available() {
+#ifdef NFORCE_TRACE
+  return true;
+#else
+  return false;
+#endif
+}
+
+void enable_tracing(bool on) {
+  g_enabled.store(on && tracing_available(), std::memory_order_relaxed);
+}
+
+bool tracing_enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+std::vector<trace_event> drain_traces() {
+  std::vector<trace_event> events;
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock{r.mutex};
+  for (const auto &ring : r.rings) {
+    ring->drain(events);
+  }
+  return events;
+}
+
+std::uint64_t dropped_traces() {
+  std::uint64_t dropped = 0;
+  auto &r = registry();
+  std::lock_guard<std::mutex> lock{r.mutex};
+  for (const auto &ring : r.rings) {
+    dropped += ring->dropped();
+  }
+  return dropped;
+}
+
+void write_chrome_trace(std::ostream &os,
+                        const std::vector<trace_event> &events) {
+  // complete events, timestamps and durations in microseconds
+  auto flags = os.flags();
+  os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  for (std::size_t i = 0; i < events.size(); ++i) {
+    const auto &e = events[i];
+    os << (i ? ",\n" : "\n") << "{\"name\":\"" << phase_name(e.phase)
+       << "\",\"cat\":\"nforce\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+       << ",\"ts\":" << e.begin / 1000.0
+       << ",\"dur\":" << (e.end - e.begin) / 1000.0
+       << ",\"args\":{\"expr\":" << e.expr_id;
+    if (e.handler != trace_event::no_handler) {
+      os << ",\"handler\":" << e.handler;
+    }
+    os << "}}";
+  }
+  os << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  os.flags(flags);
+}
+
+trace_span::trace_span(trace_phase phase, std::uint32_t handler)
+    : trace_span{phase, handler, t_expr} {}
+
+trace_span::trace_span(trace_phase phase, std::uint32_t handler,
+                       std::uint64_t expr_id)
+    : m_active{tracing_enabled()} {
+  if (m_active) {
+    m_event.phase = phase;
+    m_event.expr_id = expr_id;
+    m_event.handler = handler;
+    m_event.begin = now();
+  }
+}
+
+trace_span::~trace_span() {
+  if (m_active) {
+    m_event.end = now();
+    auto &ring = local_ring();
+    m_event.thread = ring.thread();
+    ring.push(m_event);
+  }
+}
+
+trace_expr_scope::trace_expr_scope()
+    : m_id{g_expr_ids.fetch_add(1, std::memory_order_relaxed) + 1},
+      m_prev{t_expr} {
+  t_expr = m_id;
+}
+
+trace_expr_scope::~trace_expr_scope() { t_expr = m_prev; }
+
+std::uint64_t current_trace_expr() { return t_expr; }
+} // namespace n4
@@ -0,0 +1,140 @@
+#include "nforce/truth_table.h"
+#include "nforce/core/except.h"
+
+namespace n4 {
+//-------------------------------------
+// Private
+
+namespace {
+// evaluate the skeleton on 64 leaf assignments at once
+class skeleton_eval final : public expr_visitor {
+public:
+  skeleton_eval(const leaf_set &leaves,
+                const std::vector<std::uint64_t> &columns)
+      : m_leaves{leaves}, m_columns{columns} {}
+
+  std::uint64_t eval(const expr &e) {
+    e.accept(*this);
+    return m_res;
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::OR> &e) override {
+    auto [op1, op2] = this->binary(e.left_op(), e.right_op());
+    m_res = op1 | op2;
+  }
+
+  void visit(const binary_gen_expr<binary_op_type::AND> &e) override {
+    auto [op1, op2] = this->binary(e.left_op(), e.right_op());
+    m_res = op1 & op2;
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::OR> &e) override {
+    std::uint64_t res = 0;
+    for (std::size_t i = 0, n = this->nary_size(e); i < n; ++i) {
+      res |= this->eval(*e.op(i));
+    }
+    m_res = res;
+  }
+
+  void visit(const nary_gen_expr<binary_op_type::AND> &e) override {
+    auto res = ~std::uint64_t{0};
+    for (std::size_t i = 0, n = this->nary_size(e); i < n; ++i) {
+      res &= this->eval(*e.op(i));
+    }
+    m_res = res;
+  }
+
+  void visit(const unary_not_expr &e) override {
+    if (!e.op()) {
+      throw nexcept("[nforce] missing unary operand", status_type::BAD_AST);
+    }
+    m_res = ~this->eval(*e.op());
+  }
+
+  void visit(const rule_expr &e) override {
+    m_res = m_columns[m_leaves.index_of(e)];
+  }
+
+private:
+  template <binary_op_type Op>
+  std::size_t nary_size(const nary_gen_expr<Op> &e) const {
+    if (e.size() == 0) {
+      throw nexcept("[nforce] missing n-ary operand", status_type::BAD_AST);
+    }
+    for (std::size_t i = 0; i < e.size(); ++i) {
+      if (!e.op(i)) {
+        throw nexcept("[nforce] missing n-ary operand", status_type::BAD_AST);
+      }
+    }
+    return e.size();
+  }
+
+  std::pair<std::uint64_t, std::uint64_t> binary(const expr *op1,
+                                                 const expr *op2) {
+    if (!op1 || !op2) {
+      throw nexcept("[nforce] missing binary operand", status_type::BAD_AST);
+    }
+    auto res1 = this->eval(*op1);
+    return {res1, this->eval(*op2)};
+  }
+
+  const leaf_set &m_leaves;
+  const std::vector<std::uint64_t> &m_columns;
+  std::uint64_t m_res{0};
+};
+
+// leaf i values over the 64 indices of a table word
+constexpr std::uint64_t low_columns[] = {
+    0xaaaaaaaaaaaaaaaa, 0xcccccccccccccccc, 0xf0f0f0f0f0f0f0f0,
+    0xff00ff00ff00ff00, 0xffff0000ffff0000, 0xffffffff00000000};
+
+const expr &checked(const std::unique_ptr<expr> &root) {
+  if (!root) {
+    throw nexcept("[nforce] missing expression", status_type::BAD_AST);
+  }
+  return *root;
+}
+} // namespace
+
+//-------------------------------------
+// Public
+
+truth_table_expr::truth_table_expr(std::unique_ptr<expr> root)
+    : m_root{std::move(root)}, m_leaves{checked(m_root)} {
+  if (m_leaves.size() > max_leaves) {
+    throw nexcept("[nforce] too many leaves for truth table",
+                  status_type::BAD_AST);
+  }
+
+  auto words = std::size_t{1} << (m_leaves.size() > 6 ? m_leaves.size() - 6
+                                                       : 0);
+  m_table.resize(words);
+
+  std::vector<std::uint64_t> columns(m_leaves.size());
+  skeleton_eval eval{m_leaves, columns};
+  for (std::size_t w = 0; w < words; ++w) {
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+      columns[i] = (i < 6) ? low_columns[i]
+                           : (((w >> (i - 6)) & 1u) ? ~std::uint64_t{0} : 0);
+    }
+    m_table[w] = eval.eval(*m_root);
+  }
+}
+
+bool truth_table_expr::interpret() const {
+  std::uint32_t index = 0;
+  for (std::size_t i = 0; i < m_leaves.size(); ++i) {
+    index |= static_cast<std::uint32_t>(m_leaves[i].interpret()) << i;
+  }
+  return this->lookup(index);
+}
+
+std::unique_ptr<expr> compile_truth_table(std::unique_ptr<expr> root,
+                                          std::size_t max_leaves) {
+  if (leaf_set{checked(root)}.size() >
+      std::min(max_leaves, truth_table_expr::max_leaves)) {
+    return root;
+  }
+  return std::make_unique<truth_table_expr>(std::move(root));
+}
+} // namespace n4
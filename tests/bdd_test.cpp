@@ -0,0 +1,152 @@
+#include <map>
+
+#include "gtest/gtest.h"
+
+#include "nforce/bdd.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+
+#include "random_expr.h"
+
+using namespace n4;
+
+namespace {
+template <binary_op_type Op>
+std::unique_ptr<expr> make(std::unique_ptr<expr> op1,
+                           std::unique_ptr<expr> op2) {
+  auto e = std::make_unique<binary_gen_expr<Op>>();
+  e->set_left_op(std::move(op1));
+  e->set_right_op(std::move(op2));
+  return e;
+}
+
+// leaves counting their evaluations
+struct counted_leaves {
+  std::unique_ptr<expr> leaf(const std::string &rule) {
+    return std::make_unique<rule_expr>(
+        [this, rule] {
+          ++counts[rule];
+          return values[rule];
+        },
+        rule);
+  }
+
+  std::map<std::string, bool> values;
+  std::map<std::string, std::size_t> counts;
+};
+} // namespace
+
+TEST(bdd_test, interpret_exhaustive) {
+  for (unsigned seed = 0; seed < 50; ++seed) {
+    test::random_expr gen{8, seed};
+    auto ref = gen.make(6);
+
+    test::random_expr gen2{8, seed};
+    bdd_expr bdd{gen2.make(6)};
+
+    for (std::size_t i = 0; i < (1u << 8); ++i) {
+      gen.assign(i);
+      gen2.assign(i);
+      ASSERT_EQ(bdd.interpret(), ref->interpret()) << seed << " " << i;
+    }
+  }
+}
+
+TEST(bdd_test, interpret_once_per_leaf) {
+  // ('ra' & 'rb') | ('ra' & 'rc') | ('rd' & 'ra')
+  counted_leaves l;
+  auto root = make<binary_op_type::OR>(
+      make<binary_op_type::AND>(l.leaf("ra"), l.leaf("rb")),
+      make<binary_op_type::OR>(
+          make<binary_op_type::AND>(l.leaf("ra"), l.leaf("rc")),
+          make<binary_op_type::AND>(l.leaf("rd"), l.leaf("ra"))));
+
+  bdd_expr bdd{std::move(root)};
+  ASSERT_EQ(bdd.leaves().size(), 4u);
+
+  // most shared leaf first
+  EXPECT_EQ(bdd.leaves()[bdd.order()[0]].rule(), "ra");
+
+  // 'ra' decides alone
+  l.values = {{"ra", false}, {"rb", true}, {"rc", true}, {"rd", true}};
+  EXPECT_FALSE(bdd.interpret());
+  EXPECT_EQ(l.counts["ra"], 1u);
+  EXPECT_EQ(l.counts.size(), 1u);
+
+  for (std::size_t i = 0; i < 16; ++i) {
+    l.values = {{"ra", i & 1}, {"rb", i & 2}, {"rc", i & 4}, {"rd", i & 8}};
+    l.counts.clear();
+
+    auto expected = (l.values["ra"] && l.values["rb"]) ||
+                    (l.values["ra"] && l.values["rc"]) ||
+                    (l.values["rd"] && l.values["ra"]);
+    EXPECT_EQ(bdd.interpret(), expected);
+    for (const auto &c : l.counts) {
+      EXPECT_EQ(c.second, 1u) << c.first;
+    }
+  }
+}
+
+TEST(bdd_test, build_cost_order) {
+  counted_leaves l;
+  auto root = make<binary_op_type::AND>(l.leaf("slow"), l.leaf("fast"));
+
+  bdd_expr bdd{std::move(root), bdd_expr::default_max_nodes,
+               [](const rule_expr &r) {
+                 return r.rule() == "slow" ? 10.0 : 1.0;
+               }};
+  EXPECT_EQ(bdd.leaves()[bdd.order()[0]].rule(), "fast");
+  EXPECT_EQ(bdd.node_count(), 2u);
+
+  l.values = {{"slow", true}, {"fast", false}};
+  EXPECT_FALSE(bdd.interpret());
+  EXPECT_EQ(l.counts.count("slow"), 0u);
+}
+
+TEST(bdd_test, compile_fallback) {
+  test::random_expr gen{12, 3};
+
+  // (r0 & r1) | (r2 & r3) | ... requires more than 4 nodes
+  std::unique_ptr<expr> root =
+      make<binary_op_type::AND>(gen.leaf(0), gen.leaf(1));
+  for (std::size_t i = 2; i < 12; i += 2) {
+    root = make<binary_op_type::OR>(
+        std::move(root),
+        make<binary_op_type::AND>(gen.leaf(i), gen.leaf(i + 1)));
+  }
+
+  const auto *src = root.get();
+  try {
+    bdd_expr(std::move(root), 4);
+    ADD_FAILURE() << "size cap not enforced";
+  } catch (const nexcept &e) {
+    EXPECT_EQ(e.status(), status_type::INTERNAL_ERROR);
+  }
+  EXPECT_EQ(root.get(), src);
+
+  auto compiled = compile_bdd(std::move(root), 4);
+  EXPECT_EQ(compiled.get(), src);
+
+  compiled = compile_bdd(std::move(compiled));
+  auto *bdd = dynamic_cast<bdd_expr *>(compiled.get());
+  ASSERT_NE(bdd, nullptr);
+  EXPECT_EQ(bdd->node_count(), 12u);
+}
+
+TEST(bdd_test, build_bad_ast) {
+  auto e = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  e->set_left_op(std::make_unique<rule_expr>([] { return true; }));
+
+  EXPECT_THROW(compile_bdd(std::move(e)), nexcept);
+  EXPECT_THROW(compile_bdd(nullptr), nexcept);
+}
+
+//-------------------------------------
+// Entry point
+
+int bdd_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "bdd_test*";
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,136 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "nforce/columnar.h"
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/lexer.h"
+#include "nforce/parser.h"
+
+using namespace n4;
+
+namespace {
+struct columnar_test : public ::testing::Test {
+  columnar_test() : cols{rows} {
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<std::int64_t> price{-100, 100};
+    std::uniform_int_distribution<std::size_t> pick{0, 4};
+    const char *names[] = {"CreateFileA", "CreateFileW", "ReadFile", "Close",
+                           ""};
+
+    offsets.push_back(0);
+    for (std::size_t i = 0; i < rows; ++i) {
+      prices.push_back(price(gen));
+      bytes += names[pick(gen)];
+      offsets.push_back(static_cast<std::uint32_t>(bytes.size()));
+    }
+
+    cols.add("price", prices.data());
+    cols.add("name", offsets.data(), bytes.data());
+  }
+
+  std::unique_ptr<expr> build(const std::string &filter) {
+    lexer lexer{filter};
+    parser parser{lexer,
+                  std::vector<parser::rule_handler>{cols.handler(row)}};
+    return parser.build();
+  }
+
+  // compare columnar scan of a slice with row by row interpretation
+  void check(const std::string &filter, std::size_t first, std::size_t count,
+             bool simd) {
+    auto e = this->build(filter);
+    columnar_scan scan{*e, cols, columnar_options{simd, 256}};
+
+    bitmap bits;
+    scan.scan(first, count, bits);
+    ASSERT_EQ(bits.size(), (count + 63) / 64);
+
+    std::size_t matches = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+      row = first + i;
+      auto expected = e->interpret();
+      matches += expected ? 1 : 0;
+      ASSERT_EQ(((bits[i / 64] >> (i % 64)) & 1u) != 0, expected)
+          << filter << " row " << row;
+    }
+    EXPECT_EQ(match_count(bits, count), matches);
+  }
+
+  static constexpr std::size_t rows = 5000;
+  std::vector<std::int64_t> prices;
+  std::vector<std::uint32_t> offsets;
+  std::string bytes;
+  column_set cols;
+  std::size_t row{0};
+};
+} // namespace
+
+TEST_F(columnar_test, scan_int) {
+  for (auto simd : {false, true}) {
+    for (const auto *f : {"'price==0'", "'price!=0'", "'price<10'",
+                          "'price<=10'", "'price>-5'", "'price>=-5'"}) {
+      this->check(f, 0, rows, simd);
+      this->check(f, 37, 1111, simd);
+    }
+  }
+}
+
+TEST_F(columnar_test, scan_string) {
+  for (const auto *f : {"'name==Close'", "'name!=Close'",
+                        "'name^=Create'", "'name*=File'", "'name*=W'"}) {
+    this->check(f, 0, rows, true);
+    this->check(f, 3, 64, true);
+  }
+}
+
+TEST_F(columnar_test, scan_structure) {
+  for (auto simd : {false, true}) {
+    this->check("'name^=Create' & ('price>50' | 'price<-50')", 0, rows, simd);
+    this->check("'name*=File' | 'price==1' | 'price==2' & 'name==Close'", 5,
+                rows - 10, simd);
+    this->check("('price>0' & 'name^=Read') | ('price>0' & 'name==')", 0,
+                rows, simd);
+  }
+
+  // not is only built by hand
+  auto n = std::make_unique<unary_not_expr>();
+  n->set_op(this->build("'price>0' | 'name==Close'"));
+  columnar_scan scan{*n, cols};
+
+  auto bits = scan.scan();
+  for (row = 0; row < rows; ++row) {
+    ASSERT_EQ(((bits[row / 64] >> (row % 64)) & 1u) != 0, n->interpret());
+  }
+}
+
+TEST_F(columnar_test, build_bad_rule) {
+  EXPECT_THROW(this->build("'price^=1'"), nexcept);
+  EXPECT_THROW(this->build("'price==1x'"), nexcept);
+  EXPECT_THROW(this->build("'name<1'"), nexcept);
+  EXPECT_THROW(this->build("'size==1'"), nexcept);
+  EXPECT_THROW(this->build("'price='"), nexcept);
+
+  rule_expr other{[] { return true; }, "size==1"};
+  EXPECT_THROW(columnar_scan(other, cols), nexcept);
+
+  auto e = this->build("'price==1'");
+  columnar_scan scan{*e, cols};
+  bitmap bits;
+  EXPECT_THROW(scan.scan(rows, 1, bits), nexcept);
+  EXPECT_NO_THROW(scan.scan(rows, 0, bits));
+  EXPECT_TRUE(bits.empty());
+}
+
+//-------------------------------------
+// Entry point
+
+int columnar_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "columnar_test*";
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,135 @@
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/cost.h"
+#include "nforce/expr.h"
+#include "nforce/lexer.h"
+#include "nforce/memo.h"
+#include "nforce/parser.h"
+#include "nforce/specialize.h"
+
+using namespace n4;
+
+namespace {
+struct cost_test : public ::testing::Test {
+  // "re=..." rules are expensive and rarely hold, others are cheap
+  std::unique_ptr<expr> build(const std::string &filter) {
+    lexer lex{filter};
+    parser p{lex, std::vector<parser::rule_handler>{
+                      {[](const std::string &str) {
+                         return str.rfind("re=", 0) == 0;
+                       },
+                       [](const std::string &) { return false; },
+                       rule_cost{100.0, 20.0, 0.1}},
+                      {[](const std::string &) { return true; },
+                       [](const std::string &) { return true; }}}};
+    return p.build();
+  }
+};
+} // namespace
+
+TEST_F(cost_test, static_cost_main) {
+  // 'ab' | ('re=x' & 'cd')
+  auto c = static_cost(*this->build("'ab' | 're=x' & 'cd'"));
+
+  EXPECT_EQ(c.nodes, 5u);
+  EXPECT_EQ(c.depth, 3u);
+  EXPECT_EQ(c.leaves, 3u);
+  EXPECT_DOUBLE_EQ(c.worst, 102.0);
+
+  // 're=x' is reached half of the time, 'cd' when 're=x' also holds
+  EXPECT_DOUBLE_EQ(c.expected, 1.0 + 0.5 * (20.0 + 0.1 * 1.0));
+}
+
+TEST_F(cost_test, static_cost_shared) {
+  auto c = static_cost(*this->build("'re=x' & 'ab' | 're=x' & 'cd'"));
+
+  // each occurrence is evaluated, distinct leaves are counted once
+  EXPECT_EQ(c.leaves, 3u);
+  EXPECT_DOUBLE_EQ(c.worst, 202.0);
+}
+
+TEST_F(cost_test, static_cost_transformed) {
+  // rebuilt leaves keep the cost hints of their handler
+  auto root = this->build("'ab' | 're=x' & 'cd'");
+
+  auto residual = specialize(
+      *root, std::unordered_map<std::string, bool>{{"ab", false}});
+  auto c = static_cost(*residual);
+  EXPECT_DOUBLE_EQ(c.worst, 101.0);
+  EXPECT_DOUBLE_EQ(c.expected, 20.0 + 0.1 * 1.0);
+
+  std::string value;
+  memo_expr memo{std::move(root), [&value](const rule_expr &) {
+                   return field_reader{[&value] {
+                     return std::string_view{value};
+                   }};
+                 }};
+  c = static_cost(memo);
+  EXPECT_DOUBLE_EQ(c.worst, 102.0);
+  EXPECT_DOUBLE_EQ(c.expected, 1.0 + 0.5 * (20.0 + 0.1 * 1.0));
+}
+
+TEST_F(cost_test, static_cost_default) {
+  // hint free leaves cost 1 and hold half of the time
+  auto leaf = [] { return std::make_unique<rule_expr>([] { return true; }); };
+  binary_gen_expr<binary_op_type::AND> e;
+  e.set_left_op(leaf());
+  e.set_right_op(leaf());
+
+  auto c = static_cost(e);
+  EXPECT_EQ(c.nodes, 3u);
+  EXPECT_EQ(c.depth, 2u);
+  EXPECT_DOUBLE_EQ(c.worst, 2.0);
+  EXPECT_DOUBLE_EQ(c.expected, 1.5);
+
+  // negation flips the probability of the right operand being reached
+  binary_gen_expr<binary_op_type::AND> n;
+  auto no = std::make_unique<unary_not_expr>();
+  no->set_op(std::make_unique<rule_expr>([] { return true; }, "ab",
+                                         rule_cost{1.0, 1.0, 0.9}));
+  n.set_left_op(std::move(no));
+  n.set_right_op(leaf());
+
+  c = static_cost(n);
+  EXPECT_EQ(c.nodes, 4u);
+  EXPECT_EQ(c.depth, 3u);
+  EXPECT_DOUBLE_EQ(c.expected, 1.0 + (1.0 - 0.9));
+
+  binary_gen_expr<binary_op_type::AND> incomplete;
+  incomplete.set_left_op(leaf());
+  EXPECT_THROW(static_cost(incomplete), nexcept);
+}
+
+TEST_F(cost_test, within_main) {
+  expr_cost c;
+  c.nodes = 10;
+  c.depth = 3;
+  c.leaves = 5;
+  c.worst = 50.0;
+  c.expected = 5.0;
+
+  EXPECT_TRUE(within(c, cost_budget{}));
+
+  cost_budget b;
+  b.nodes = 10;
+  b.worst = 50.0;
+  EXPECT_TRUE(within(c, b));
+
+  b.leaves = 4;
+  EXPECT_FALSE(within(c, b));
+
+  b.leaves = 0;
+  b.expected = 4.5;
+  EXPECT_FALSE(within(c, b));
+}
+
+//-------------------------------------
+// Entry point
+
+int cost_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "cost_test*";
+
+  return RUN_ALL_TESTS();
+}
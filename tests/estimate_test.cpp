@@ -0,0 +1,158 @@
+#include <set>
+
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/estimate.h"
+#include "nforce/expr.h"
+
+using namespace n4;
+
+namespace {
+struct estimate_test : public ::testing::Test {
+  // "mod3" holds for multiples of 3, "lt1000" for records below 1000
+  estimate_test() {
+    auto e = std::make_unique<any_of_expr>();
+    e->add_op(std::make_unique<rule_expr>([this] { return curr % 3 == 0; },
+                                          "mod3"));
+    e->add_op(
+        std::make_unique<rule_expr>([this] { return curr < 1000; }, "lt1000"));
+    root = std::move(e);
+  }
+
+  record_loader loader() {
+    return [this](std::size_t i) {
+      curr = i;
+      loaded.insert(i);
+      ++loads;
+    };
+  }
+
+  std::size_t exact(std::size_t first, std::size_t last) const {
+    std::size_t count = 0;
+    for (auto i = first; i < last; ++i) {
+      count += (i % 3 == 0 || i < 1000) ? 1 : 0;
+    }
+    return count;
+  }
+
+  std::unique_ptr<expr> root;
+  std::size_t curr{0};
+  std::set<std::size_t> loaded;
+  std::size_t loads{0};
+};
+} // namespace
+
+TEST_F(estimate_test, estimate_exact) {
+  estimate_options opts;
+  opts.precision = 0.0;
+  auto res = estimate_count(*root, 100, 5100, this->loader(), opts);
+
+  EXPECT_TRUE(res.exact());
+  EXPECT_EQ(res.population, 5000u);
+  EXPECT_EQ(res.matched, this->exact(100, 5100));
+  EXPECT_DOUBLE_EQ(res.count, static_cast<double>(res.matched));
+  EXPECT_DOUBLE_EQ(res.low, res.count);
+  EXPECT_DOUBLE_EQ(res.high, res.count);
+  EXPECT_EQ(loaded.size(), 5000u);
+  EXPECT_EQ(*loaded.begin(), 100u);
+  EXPECT_EQ(*loaded.rbegin(), 5099u);
+}
+
+TEST_F(estimate_test, estimate_early_stop) {
+  const std::size_t n = 100000;
+  auto expected = static_cast<double>(this->exact(0, n));
+
+  estimate_options opts;
+  opts.confidence = 0.999;
+  opts.precision = 0.02;
+  for (std::uint64_t seed = 0; seed < 10; ++seed) {
+    loaded.clear();
+    loads = 0;
+    opts.seed = seed;
+    auto res = estimate_count(*root, 0, n, this->loader(), opts);
+
+    // records are drawn without replacement
+    EXPECT_EQ(loads, res.sampled);
+    EXPECT_EQ(loaded.size(), res.sampled);
+    EXPECT_FALSE(res.exact());
+    EXPECT_LT(res.sampled, n / 10);
+    EXPECT_LE(res.high - res.low, 2.0 * opts.precision * n);
+    EXPECT_LE(res.low, expected);
+    EXPECT_GE(res.high, expected);
+    EXPECT_LE(res.low, res.count);
+    EXPECT_GE(res.high, res.count);
+  }
+
+  // same seed, same sample
+  opts.seed = 3;
+  auto a = estimate_count(*root, 0, n, this->loader(), opts);
+  auto b = estimate_count(*root, 0, n, this->loader(), opts);
+  EXPECT_EQ(a.sampled, b.sampled);
+  EXPECT_EQ(a.matched, b.matched);
+}
+
+TEST_F(estimate_test, estimate_max_sample) {
+  estimate_options opts;
+  opts.precision = 0.0;
+  opts.max_sample = 500;
+  auto res = estimate_count(*root, 0, 10000, this->loader(), opts);
+
+  EXPECT_EQ(res.sampled, 500u);
+  EXPECT_EQ(loaded.size(), 500u);
+  EXPECT_FALSE(res.exact());
+  EXPECT_LT(res.low, res.count);
+  EXPECT_GT(res.high, res.count);
+}
+
+TEST_F(estimate_test, estimate_leaves) {
+  estimate_options opts;
+  opts.leaf_selectivity = true;
+  opts.confidence = 0.999;
+  auto res = estimate_count(*root, 0, 30000, this->loader(), opts);
+
+  ASSERT_EQ(res.leaves.size(), 2u);
+  EXPECT_EQ(res.leaves[0].rule, "mod3");
+  EXPECT_EQ(res.leaves[1].rule, "lt1000");
+
+  const double expected[] = {1.0 / 3.0, 1.0 / 30.0};
+  for (std::size_t k = 0; k < 2; ++k) {
+    const auto &l = res.leaves[k];
+    EXPECT_LE(l.low, expected[k]);
+    EXPECT_GE(l.high, expected[k]);
+    EXPECT_LE(l.low, l.selectivity);
+    EXPECT_GE(l.high, l.selectivity);
+  }
+
+  // leaves are evaluated on their own, regardless of short-circuits
+  EXPECT_GT(res.leaves[1].matched, 0u);
+}
+
+TEST_F(estimate_test, estimate_invalid) {
+  auto empty = estimate_count(*root, 10, 10, this->loader());
+  EXPECT_TRUE(empty.exact());
+  EXPECT_EQ(empty.matched, 0u);
+  EXPECT_EQ(loads, 0u);
+
+  EXPECT_THROW(estimate_count(*root, 10, 5, this->loader()), nexcept);
+
+  estimate_options opts;
+  opts.confidence = 1.0;
+  EXPECT_THROW(estimate_count(*root, 0, 10, this->loader(), opts), nexcept);
+
+  auto incomplete = std::make_unique<any_of_expr>();
+  opts.confidence = 0.95;
+  opts.leaf_selectivity = true;
+  EXPECT_THROW(estimate_count(*incomplete, 0, 10, this->loader(), opts),
+               nexcept);
+}
+
+//-------------------------------------
+// Entry point
+
+int estimate_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "estimate_test*";
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,119 @@
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "nforce/executor.h"
+
+using namespace n4;
+
+TEST(executor_test, bulk_main) {
+  executor ex{4};
+  EXPECT_EQ(ex.size(), 4u);
+
+  std::vector<int> hits(1000, 0);
+  std::vector<std::atomic<int>> workers(ex.size());
+  ex.bulk(hits.size(), [&](std::size_t i, std::size_t w) {
+    ++hits[i];
+    ++workers[w];
+  });
+
+  for (auto h : hits) {
+    EXPECT_EQ(h, 1);
+  }
+
+  int total = 0;
+  for (auto &w : workers) {
+    total += w.load();
+  }
+  EXPECT_EQ(total, 1000);
+}
+
+TEST(executor_test, bulk_empty) {
+  executor ex{2};
+  EXPECT_NO_THROW(ex.bulk(0, [](std::size_t, std::size_t) {
+    throw std::runtime_error("unexpected");
+  }));
+}
+
+TEST(executor_test, bulk_exception) {
+  executor ex{3};
+  std::atomic<int> calls{0};
+  EXPECT_THROW(ex.bulk(100,
+                       [&](std::size_t i, std::size_t) {
+                         ++calls;
+                         if (i == 42) {
+                           throw std::runtime_error("bad block");
+                         }
+                       }),
+               std::runtime_error);
+
+  // all calls are done before rethrowing
+  EXPECT_EQ(calls.load(), 100);
+}
+
+TEST(executor_test, submit_main) {
+  std::atomic<int> calls{0};
+  {
+    executor ex{2};
+    for (int i = 0; i < 100; ++i) {
+      ex.submit([&](std::size_t w) {
+        EXPECT_LT(w, 2u);
+        ++calls;
+      });
+    }
+  }
+
+  // pending tasks are run before destruction
+  EXPECT_EQ(calls.load(), 100);
+}
+
+TEST(executor_test, submit_exception) {
+  std::atomic<int> calls{0};
+  {
+    executor ex{1};
+    ex.submit([](std::size_t) { throw std::runtime_error("bad task"); });
+    ex.submit([&](std::size_t) { ++calls; });
+    while (ex.load() != 0)
+      std::this_thread::yield();
+
+    // worker survived and accounting is balanced
+    EXPECT_EQ(calls.load(), 1);
+    EXPECT_EQ(ex.load(), 0u);
+  }
+  EXPECT_EQ(calls.load(), 1);
+}
+
+TEST(executor_test, load_main) {
+  executor ex{1};
+  std::atomic<bool> started{false};
+  std::atomic<bool> release{false};
+
+  EXPECT_EQ(ex.load(), 0u);
+  ex.submit([&](std::size_t) {
+    started = true;
+    while (!release)
+      std::this_thread::yield();
+  });
+  while (!started)
+    std::this_thread::yield();
+
+  // running task is accounted for
+  EXPECT_EQ(ex.load(), 1u);
+  release = true;
+  while (ex.load() != 0)
+    std::this_thread::yield();
+  EXPECT_EQ(ex.load(), 0u);
+}
+
+//-------------------------------------
+// Entry point
+
+int executor_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "executor_test*";
+
+  return RUN_ALL_TESTS();
+}
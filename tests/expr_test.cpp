@@ -61,6 +61,123 @@ TEST(expr_test, interpret_bad_rule) {
   EXPECT_THROW(expr.interpret(), nexcept);
 }
 
+TEST(expr_test, interpret_set_rule) {
+  rule_expr expr;
+  expr.set_interpretor([] { return true; });
+  EXPECT_TRUE(expr.interpret());
+
+  expr.set_interpretor([] { return false; });
+  EXPECT_FALSE(expr.interpret());
+}
+
+TEST(expr_test, interpret_nary) {
+  int calls = 0;
+  auto leaf = [&calls](bool v) {
+    return std::make_unique<rule_expr>([&calls, v] {
+      ++calls;
+      return v;
+    });
+  };
+
+  all_of_expr all;
+  all.add_op(leaf(true));
+  all.add_op(leaf(false));
+  all.add_op(leaf(true));
+  EXPECT_FALSE(all.interpret());
+  EXPECT_EQ(calls, 2);
+
+  any_of_expr any;
+  any.add_op(leaf(false));
+  any.add_op(leaf(true));
+  any.add_op(leaf(false));
+  calls = 0;
+  EXPECT_TRUE(any.interpret());
+  EXPECT_EQ(calls, 2);
+
+  any_of_expr none;
+  none.add_op(leaf(false));
+  EXPECT_FALSE(none.interpret());
+}
+
+TEST(expr_test, interpret_bad_nary) {
+  all_of_expr expr;
+  EXPECT_THROW(expr.interpret(), nexcept);
+
+  expr.add_op(nullptr);
+  EXPECT_THROW(expr.interpret(), nexcept);
+}
+
+TEST(expr_test, flatten_chain) {
+  // ((r0 | r1) | (r2 | !(r3 & (r4 & r5))))
+  auto leaf = [](bool v) {
+    return std::make_unique<rule_expr>([v] { return v; });
+  };
+  auto a1 = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  a1->set_left_op(leaf(true));
+  a1->set_right_op(leaf(true));
+  auto a2 = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  a2->set_left_op(leaf(true));
+  a2->set_right_op(std::move(a1));
+  auto n = std::make_unique<unary_not_expr>();
+  n->set_op(std::move(a2));
+  auto o1 = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  o1->set_left_op(leaf(false));
+  o1->set_right_op(leaf(false));
+  auto o2 = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  o2->set_left_op(leaf(false));
+  o2->set_right_op(std::move(n));
+  auto root = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  root->set_left_op(std::move(o1));
+  root->set_right_op(std::move(o2));
+
+  auto flat = flatten(std::move(root));
+  auto any = dynamic_cast<any_of_expr *>(flat.get());
+  ASSERT_NE(any, nullptr);
+  ASSERT_EQ(any->size(), 4u);
+
+  auto not_op = dynamic_cast<const unary_not_expr *>(any->op(3));
+  ASSERT_NE(not_op, nullptr);
+  auto all = dynamic_cast<const all_of_expr *>(not_op->op());
+  ASSERT_NE(all, nullptr);
+  EXPECT_EQ(all->size(), 3u);
+
+  EXPECT_FALSE(flat->interpret());
+}
+
+TEST(expr_test, flatten_long_chain) {
+  // deep right leaning chain that would exhaust the stack if recursed
+  std::unique_ptr<expr> root =
+      std::make_unique<rule_expr>([] { return true; });
+  for (int i = 0; i < 1000000; ++i) {
+    auto e = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+    e->set_left_op(std::make_unique<rule_expr>([] { return true; }));
+    e->set_right_op(std::move(root));
+    root = std::move(e);
+  }
+
+  auto flat = flatten(std::move(root));
+  auto all = dynamic_cast<all_of_expr *>(flat.get());
+  ASSERT_NE(all, nullptr);
+  EXPECT_EQ(all->size(), 1000001u);
+  EXPECT_TRUE(flat->interpret());
+}
+
+TEST(expr_test, flatten_single) {
+  auto all = std::make_unique<all_of_expr>();
+  all->add_op(std::make_unique<rule_expr>([] { return true; }));
+
+  auto flat = flatten(std::move(all));
+  EXPECT_NE(dynamic_cast<rule_expr *>(flat.get()), nullptr);
+}
+
+TEST(expr_test, flatten_bad_ast) {
+  auto e = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  e->set_left_op(std::make_unique<rule_expr>([] { return true; }));
+
+  EXPECT_THROW(flatten(std::move(e)), nexcept);
+  EXPECT_THROW(flatten(nullptr), nexcept);
+}
+
 //-------------------------------------
 // Entry point
 
@@ -0,0 +1,125 @@
+#include <map>
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/jit.h"
+
+#include "random_expr.h"
+
+using namespace n4;
+
+TEST(jit_test, interpret_differential) {
+  if (!jit_expr::available()) {
+    return;
+  }
+
+  constexpr std::size_t leaves = 6;
+  for (unsigned seed = 0; seed < 200; ++seed) {
+    test::random_expr gen{leaves, seed};
+    auto root = gen.make(5);
+    const auto *src = root.get();
+
+    jit_expr jit{std::move(root)};
+    EXPECT_GT(jit.code_size(), 0u);
+    for (std::size_t a = 0; a < (1u << leaves); ++a) {
+      gen.assign(a);
+      EXPECT_EQ(jit.interpret(), src->interpret()) << seed << " " << a;
+    }
+  }
+}
+
+TEST(jit_test, interpret_short_circuit) {
+  if (!jit_expr::available()) {
+    return;
+  }
+
+  std::map<std::string, int> counts;
+  std::map<std::string, bool> values;
+  auto leaf = [&](const std::string &rule) {
+    return std::make_unique<rule_expr>(
+        [&, rule] {
+          ++counts[rule];
+          return values[rule];
+        },
+        rule);
+  };
+
+  // (ra & rb) | !rc
+  auto a = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  a->set_left_op(leaf("ra"));
+  a->set_right_op(leaf("rb"));
+  auto n = std::make_unique<unary_not_expr>();
+  n->set_op(leaf("rc"));
+  auto o = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  o->set_left_op(std::move(a));
+  o->set_right_op(std::move(n));
+
+  jit_expr jit{std::move(o)};
+  values = {{"ra", true}, {"rb", true}, {"rc", true}};
+  EXPECT_TRUE(jit.interpret());
+  EXPECT_EQ(counts["rc"], 0);
+
+  values["ra"] = false;
+  EXPECT_FALSE(jit.interpret());
+  EXPECT_EQ(counts["rb"], 1);
+  EXPECT_EQ(counts["rc"], 1);
+}
+
+TEST(jit_test, interpret_exception) {
+  if (!jit_expr::available()) {
+    return;
+  }
+
+  auto e = std::make_unique<nary_gen_expr<binary_op_type::AND>>();
+  e->add_op(std::make_unique<rule_expr>([] { return true; }, "ok"));
+  e->add_op(std::make_unique<rule_expr>(
+      []() -> bool { throw std::runtime_error{"leaf failure"}; }, "ko"));
+
+  jit_expr jit{std::move(e)};
+  EXPECT_THROW(jit.interpret(), std::runtime_error);
+  // state is left clean for the next evaluation
+  EXPECT_THROW(jit.interpret(), std::runtime_error);
+}
+
+TEST(jit_test, compile_fallback) {
+  test::random_expr gen{2, 0};
+  auto root = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  root->set_left_op(gen.leaf(0));
+  root->set_right_op(gen.leaf(1));
+  const auto *src = root.get();
+
+  auto compiled = compile_jit(std::move(root));
+  if (jit_expr::available()) {
+    EXPECT_NE(dynamic_cast<jit_expr *>(compiled.get()), nullptr);
+  } else {
+    EXPECT_EQ(compiled.get(), src);
+  }
+
+  gen.values = {false, true};
+  EXPECT_TRUE(compiled->interpret());
+}
+
+TEST(jit_test, build_bad_ast) {
+  auto e = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  e->set_left_op(std::make_unique<rule_expr>([] { return true; }));
+  const auto *src = e.get();
+
+  std::unique_ptr<expr> root = std::move(e);
+  EXPECT_THROW(jit_expr{std::move(root)}, nexcept);
+  EXPECT_EQ(root.get(), src);
+  EXPECT_THROW(compile_jit(std::move(root)), nexcept);
+  EXPECT_THROW(compile_jit(nullptr), nexcept);
+}
+
+//-------------------------------------
+// Entry point
+
+int jit_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "jit_test*";
+
+  return RUN_ALL_TESTS();
+}
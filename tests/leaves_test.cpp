@@ -0,0 +1,59 @@
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/leaves.h"
+
+using namespace n4;
+
+TEST(leaves_test, build_distinct) {
+  auto e = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  auto a = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+
+  auto r1 = std::make_unique<rule_expr>([] { return true; }, "tag=t1");
+  auto r2 = std::make_unique<rule_expr>([] { return true; }, "tag=t2");
+  auto r3 = std::make_unique<rule_expr>([] { return true; }, "tag=t1");
+  auto r4 = std::make_unique<rule_expr>([] { return true; });
+  const auto *p1 = r1.get();
+  const auto *p2 = r2.get();
+  const auto *p3 = r3.get();
+  const auto *p4 = r4.get();
+
+  a->set_left_op(std::move(r1));
+  a->set_right_op(std::move(r2));
+  auto o = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  o->set_left_op(std::move(r3));
+  o->set_right_op(std::move(r4));
+  e->set_left_op(std::move(a));
+  e->set_right_op(std::move(o));
+
+  leaf_set leaves{*e};
+  EXPECT_EQ(leaves.size(), 3u);
+  EXPECT_EQ(leaves.index_of(*p1), 0u);
+  EXPECT_EQ(leaves.index_of(*p2), 1u);
+  EXPECT_EQ(leaves.index_of(*p3), 0u);
+  EXPECT_EQ(leaves.index_of(*p4), 2u);
+  EXPECT_EQ(&leaves[0], p1);
+  EXPECT_EQ(&leaves[2], p4);
+  EXPECT_EQ(leaves.occurrences(0), 2u);
+  EXPECT_EQ(leaves.occurrences(1), 1u);
+  EXPECT_EQ(leaves.occurrences(2), 1u);
+
+  rule_expr other;
+  EXPECT_THROW(leaves.index_of(other), nexcept);
+}
+
+TEST(leaves_test, build_bad_ast) {
+  unary_not_expr e;
+  EXPECT_THROW(leaf_set{e}, nexcept);
+}
+
+//-------------------------------------
+// Entry point
+
+int leaves_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "leaves_test*";
+
+  return RUN_ALL_TESTS();
+}
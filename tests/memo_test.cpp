@@ -0,0 +1,122 @@
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/leaves.h"
+#include "nforce/memo.h"
+
+using namespace n4;
+
+namespace {
+struct memo_test : public ::testing::Test {
+  // leaf "mod=x" holds if the module starts with x, "name=x" if the name
+  // equals x
+  std::unique_ptr<expr> leaf(const std::string &rule) {
+    auto arg = rule.substr(rule.find('=') + 1);
+    if (rule.rfind("mod=", 0) == 0) {
+      return std::make_unique<rule_expr>(
+          [this, arg] {
+            ++calls;
+            return module.rfind(arg, 0) == 0;
+          },
+          rule);
+    }
+    return std::make_unique<rule_expr>(
+        [this, arg] {
+          ++calls;
+          return name == arg;
+        },
+        rule);
+  }
+
+  field_hint hint() {
+    return [this](const rule_expr &e) -> field_reader {
+      if (e.rule().rfind("mod=", 0) == 0) {
+        return [this] { return std::string_view{module}; };
+      }
+      return {};
+    };
+  }
+
+  std::string module;
+  std::string name;
+  std::size_t calls{0};
+};
+} // namespace
+
+TEST_F(memo_test, memo_hits) {
+  auto e = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  e->set_left_op(this->leaf("mod=kernel"));
+  e->set_right_op(this->leaf("name=open"));
+  memo_expr m{std::move(e), this->hint()};
+
+  const std::vector<std::string> modules{"kernel32", "user32", "ntdll"};
+  std::size_t matches = 0;
+  for (std::size_t i = 0; i < 300; ++i) {
+    module = modules[i % modules.size()];
+    name = (i % 2) ? "open" : "close";
+    matches += m.interpret();
+  }
+  EXPECT_EQ(matches, 50u);
+
+  // mod= runs once per module, name= on each kernel32 record
+  EXPECT_EQ(calls, 3u + 100u);
+
+  auto st = m.stats();
+  ASSERT_EQ(st.size(), 1u);
+  EXPECT_EQ(st[0].rule, "mod=kernel");
+  EXPECT_EQ(st[0].misses, 3u);
+  EXPECT_EQ(st[0].hits, 297u);
+  EXPECT_DOUBLE_EQ(st[0].hit_rate(), 0.99);
+
+  // analysis still sees the source leaves
+  leaf_set leaves{m};
+  EXPECT_EQ(leaves.size(), 2u);
+}
+
+TEST_F(memo_test, memo_shared) {
+  auto e = std::make_unique<nary_gen_expr<binary_op_type::OR>>();
+  e->add_op(this->leaf("mod=user"));
+  auto n = std::make_unique<unary_not_expr>();
+  n->set_op(this->leaf("mod=user"));
+  e->add_op(std::move(n));
+  e->add_op(this->leaf("mod=nt"));
+  memo_expr m{std::move(e), this->hint()};
+
+  EXPECT_EQ(m.stats().size(), 2u);
+
+  module = "kernel32";
+  EXPECT_TRUE(m.interpret());
+  module = "user32";
+  EXPECT_TRUE(m.interpret());
+  // second occurrence of mod=user hits the first one's result
+  EXPECT_EQ(calls, 2u);
+  EXPECT_EQ(m.stats()[0].hits, 1u);
+}
+
+TEST_F(memo_test, memo_bounded) {
+  memo_options opts;
+  opts.capacity = 1;
+  memo_expr m{this->leaf("mod=a"), this->hint(), opts};
+
+  // a single slot keeps the last value only
+  for (const auto *mod : {"a", "a", "b", "a", "b", "b"}) {
+    module = mod;
+    EXPECT_EQ(m.interpret(), module == "a");
+  }
+  EXPECT_EQ(m.stats()[0].hits, 2u);
+  EXPECT_EQ(m.stats()[0].misses, 4u);
+
+  auto incomplete = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  EXPECT_THROW((memo_expr{std::move(incomplete), this->hint()}), nexcept);
+}
+
+//-------------------------------------
+// Entry point
+
+int memo_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "memo_test*";
+
+  return RUN_ALL_TESTS();
+}
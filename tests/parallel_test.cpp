@@ -0,0 +1,128 @@
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/lexer.h"
+#include "nforce/parallel.h"
+#include "nforce/parser.h"
+
+using namespace n4;
+
+namespace {
+struct context {
+  int value{0};
+};
+
+// mod=N matches multiples of N, lt=N values lower than N
+bound_expr<context>::builder make_builder(const std::string &filter) {
+  return [filter](context &ctxt) {
+    auto handle = [](const std::string &str) {
+      return str.rfind("mod=", 0) == 0 || str.rfind("lt=", 0) == 0;
+    };
+    auto interpret = [&ctxt](const std::string &str) {
+      if (str.rfind("mod=", 0) == 0) {
+        return ctxt.value % std::stoi(str.substr(4)) == 0;
+      }
+      return ctxt.value < std::stoi(str.substr(3));
+    };
+
+    lexer lexer{filter};
+    parser parser{lexer,
+                  std::vector<parser::rule_handler>{{handle, interpret}}};
+    return parser.build();
+  };
+}
+
+auto bind = [](context &ctxt, int v) { ctxt.value = v; };
+
+struct parallel_test : public ::testing::Test {
+  parallel_test() : records(100000) {
+    std::iota(std::begin(records), std::end(records), 1);
+  }
+
+  std::vector<std::size_t> sequential(const std::string &filter) {
+    std::vector<std::size_t> matches;
+    bound_expr<context> e{make_builder(filter)};
+    for (std::size_t i = 0; i < records.size(); ++i) {
+      bind(e.context(), records[i]);
+      if (e.interpret()) {
+        matches.push_back(i);
+      }
+    }
+    return matches;
+  }
+
+  std::vector<int> records;
+  executor ex{4};
+};
+} // namespace
+
+TEST_F(parallel_test, filter_main) {
+  for (std::size_t bs : {1, 7, 1024, 4096, 1000000}) {
+    parallel_options opts{bs};
+    auto filter = "'mod=3' & 'mod=5' | 'lt=10'";
+
+    auto matches = parallel_filter<context>(records, make_builder(filter),
+                                            bind, ex, opts);
+    EXPECT_EQ(matches, this->sequential(filter)) << bs;
+  }
+}
+
+TEST_F(parallel_test, count_main) {
+  auto count = parallel_count<context>(records, make_builder("'mod=7'"), bind,
+                                       ex, parallel_options{100});
+  EXPECT_EQ(count, this->sequential("'mod=7'").size());
+
+  std::vector<int> empty;
+  EXPECT_EQ(parallel_count<context>(empty, make_builder("'mod=7'"), bind, ex),
+            0u);
+}
+
+TEST_F(parallel_test, find_first_main) {
+  // only one of the last records matches
+  auto first = parallel_find_first<context>(
+      records, make_builder("'mod=99991'"), bind, ex, parallel_options{128});
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(first.value(), 99990u);
+}
+
+TEST_F(parallel_test, find_first_none) {
+  auto first = parallel_find_first<context>(records, make_builder("'lt=-1'"),
+                                            bind, ex, parallel_options{128});
+  EXPECT_FALSE(first.has_value());
+
+  first = parallel_find_first<context>(records, make_builder("'mod=1000'"),
+                                       bind, ex, parallel_options{128});
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(first.value(), 999u);
+}
+
+TEST_F(parallel_test, filter_exception) {
+  auto throwing = [](context &ctxt, int v) {
+    if (v == 5000) {
+      throw std::runtime_error("bad record");
+    }
+    ctxt.value = v;
+  };
+
+  EXPECT_THROW(parallel_filter<context>(records, make_builder("'mod=2'"),
+                                        throwing, ex),
+               std::runtime_error);
+  EXPECT_THROW(
+      parallel_filter<context>(records, make_builder("'mod=2' |"), bind, ex),
+      nexcept);
+}
+
+//-------------------------------------
+// Entry point
+
+int parallel_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "parallel_test*";
+
+  return RUN_ALL_TESTS();
+}
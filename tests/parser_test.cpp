@@ -1,4 +1,6 @@
+#include <atomic>
 #include <regex>
+#include <thread>
 
 #include "gtest/gtest.h"
 
@@ -109,6 +111,182 @@ TEST_F(parser_test, build_nohandler) {
   EXPECT_THROW(expr = parser.build(), nexcept);
 }
 
+TEST_F(parser_test, build_flat_chain) {
+  std::string filter = "'tag=t0'";
+  for (int i = 1; i < 10000; ++i) {
+    filter += " | 'tag=t" + std::to_string(i) + "'";
+  }
+
+  lexer lexer{filter};
+  parser parser{lexer, std::vector<parser::rule_handler>{handler}};
+
+  std::unique_ptr<expr> expr;
+  EXPECT_NO_THROW(expr = parser.build());
+
+  auto any = dynamic_cast<any_of_expr *>(expr.get());
+  ASSERT_NE(any, nullptr);
+  EXPECT_EQ(any->size(), 10000u);
+
+  ctxt.tag = "t9999";
+  EXPECT_TRUE(expr->interpret());
+
+  ctxt.tag = "t10000";
+  EXPECT_FALSE(expr->interpret());
+}
+
+TEST_F(parser_test, build_mixed_chain) {
+  // operators are right associative: t1 & (t2 | (t3 | (t4 & t5)))
+  lexer lexer{"'tag=t1' & 'tag=t.' | 'tag=t3' | 'tag=x' & 'tag=.*'"};
+  parser parser{lexer, std::vector<parser::rule_handler>{handler}};
+
+  std::unique_ptr<expr> expr;
+  EXPECT_NO_THROW(expr = parser.build());
+
+  auto all = dynamic_cast<all_of_expr *>(expr.get());
+  ASSERT_NE(all, nullptr);
+  ASSERT_EQ(all->size(), 2u);
+
+  auto any = dynamic_cast<const any_of_expr *>(all->op(1));
+  ASSERT_NE(any, nullptr);
+  ASSERT_EQ(any->size(), 3u);
+  EXPECT_NE(dynamic_cast<const all_of_expr *>(any->op(2)), nullptr);
+
+  ctxt.tag = "t1";
+  EXPECT_TRUE(expr->interpret());
+
+  ctxt.tag = "x";
+  EXPECT_FALSE(expr->interpret());
+}
+
+TEST_F(parser_test, build_budget) {
+  auto handlers = [this] {
+    return std::vector<parser::rule_handler>{
+        {handler.first, handler.second, rule_cost{10.0, 4.0, 0.5}}};
+  };
+  const std::string filter = "'tag=t1' | 'tag=t2' | 'tag=t3'";
+
+  parser_options opts;
+  opts.budget.worst = 25.0;
+  {
+    lexer lexer{filter};
+    parser parser{lexer, handlers(), opts};
+
+    auto status = translate([&] { parser.build(); });
+    EXPECT_EQ(status, status_type::OVER_BUDGET);
+  }
+
+  opts.action = budget_action::FLAG;
+  {
+    lexer lexer{filter};
+    parser parser{lexer, handlers(), opts};
+
+    std::unique_ptr<expr> expr;
+    EXPECT_NO_THROW(expr = parser.build());
+    EXPECT_TRUE(expr);
+    EXPECT_EQ(parser.status(), status_type::OVER_BUDGET);
+  }
+
+  opts.budget.worst = 30.0;
+  {
+    lexer lexer{filter};
+    parser parser{lexer, handlers(), opts};
+
+    EXPECT_NO_THROW(parser.build());
+    EXPECT_EQ(parser.status(), status_type::SUCCESS);
+  }
+}
+
+TEST_F(parser_test, build_compiled) {
+  std::atomic<int> compiles{0};
+  auto handlers = [&] {
+    parser::compiler_cb compiler = [&](const std::string &str) {
+      ++compiles;
+      std::regex reg{str.substr(4)};
+      return rule_expr::interpretor{
+          [this, reg] { return std::regex_match(ctxt.tag, reg); }};
+    };
+    return std::vector<parser::rule_handler>{
+        {[](const std::string &str) { return str.rfind("tag=", 0) == 0; },
+         compiler}};
+  };
+  const std::string filter = "'tag=t[0-9]' | 'tag=r.*'";
+
+  // eager build compiles every rule once
+  {
+    lexer lexer{filter};
+    parser parser{lexer, handlers()};
+
+    auto expr = parser.build();
+    EXPECT_EQ(compiles.load(), 2);
+
+    ctxt.tag = "t1";
+    EXPECT_TRUE(expr->interpret());
+    ctxt.tag = "r1";
+    EXPECT_TRUE(expr->interpret());
+    EXPECT_EQ(compiles.load(), 2);
+  }
+
+  // lazy build compiles on first evaluation only
+  compiles = 0;
+  parser_options opts;
+  opts.lazy = true;
+  {
+    lexer lexer{filter};
+    parser parser{lexer, handlers(), opts};
+
+    auto expr = parser.build();
+    EXPECT_EQ(compiles.load(), 0);
+
+    ctxt.tag = "t1";
+    EXPECT_TRUE(expr->interpret());
+    EXPECT_EQ(compiles.load(), 1);
+
+    ctxt.tag = "r1";
+    EXPECT_TRUE(expr->interpret());
+    ctxt.tag = "x";
+    EXPECT_FALSE(expr->interpret());
+    EXPECT_EQ(compiles.load(), 2);
+  }
+
+  // concurrent first evaluations compile once
+  compiles = 0;
+  {
+    lexer lexer{"'tag=.*'"};
+    parser parser{lexer, handlers(), opts};
+    auto expr = parser.build();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&] { expr->interpret(); });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    EXPECT_EQ(compiles.load(), 1);
+  }
+}
+
+TEST_F(parser_test, build_lazy_error) {
+  // a rule failing to compile fails on its evaluation, not on build
+  parser::compiler_cb compiler =
+      [](const std::string &str) -> rule_expr::interpretor {
+    throw nexcept("[nforce] bad rule " + str, status_type::INTERNAL_ERROR);
+  };
+
+  parser_options opts;
+  opts.lazy = true;
+  lexer lexer{"'tag=('"};
+  parser parser{lexer,
+                std::vector<parser::rule_handler>{
+                    {[](const std::string &) { return true; }, compiler}},
+                opts};
+
+  std::unique_ptr<expr> expr;
+  EXPECT_NO_THROW(expr = parser.build());
+  EXPECT_THROW(expr->interpret(), nexcept);
+  EXPECT_THROW(expr->interpret(), nexcept);
+}
+
 //-------------------------------------
 // Entry point
 
@@ -0,0 +1,186 @@
+#include <random>
+#include <regex>
+
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/prefilter.h"
+#include "random_expr.h"
+
+using namespace n4;
+
+namespace {
+// rule "lit=xxx" requires xxx, other rules require nothing
+std::vector<std::string> lit_hint(const rule_expr &e) {
+  if (e.rule().rfind("lit=", 0) != 0) {
+    return {};
+  }
+  return {e.rule().substr(4)};
+}
+
+std::unique_ptr<expr> lit(const std::string &text) {
+  return std::make_unique<rule_expr>([] { return true; }, "lit=" + text);
+}
+
+template <binary_op_type Op>
+std::unique_ptr<expr> make(std::unique_ptr<expr> op1,
+                           std::unique_ptr<expr> op2) {
+  auto e = std::make_unique<binary_gen_expr<Op>>();
+  e->set_left_op(std::move(op1));
+  e->set_right_op(std::move(op2));
+  return e;
+}
+
+std::unique_ptr<expr> negate(std::unique_ptr<expr> op) {
+  auto e = std::make_unique<unary_not_expr>();
+  e->set_op(std::move(op));
+  return e;
+}
+} // namespace
+
+TEST(prefilter_test, clauses_and_or) {
+  // (CreateFile | OpenFile) & kernel
+  auto e = make<binary_op_type::AND>(
+      make<binary_op_type::OR>(lit("CreateFile"), lit("OpenFile")),
+      lit("kernel"));
+  prefilter pf{*e, lit_hint};
+
+  ASSERT_EQ(pf.clauses().size(), 2u);
+  EXPECT_EQ(pf.clauses()[0], prefilter::clause{"kernel"});
+  EXPECT_EQ(pf.clauses()[1], (prefilter::clause{"CreateFile", "OpenFile"}));
+
+  EXPECT_TRUE(pf.may_match("kernel32!CreateFileW"));
+  EXPECT_TRUE(pf.may_match("OpenFile@kernel"));
+  EXPECT_FALSE(pf.may_match("kernel32!ReadFile"));
+  EXPECT_FALSE(pf.may_match("CreateFileW"));
+  EXPECT_FALSE(pf.may_match(""));
+}
+
+TEST(prefilter_test, clauses_not) {
+  // a leaf under a negation requires nothing
+  auto e1 = make<binary_op_type::AND>(lit("abc"), negate(lit("def")));
+  prefilter pf1{*e1, lit_hint};
+  ASSERT_EQ(pf1.clauses().size(), 1u);
+  EXPECT_TRUE(pf1.may_match("xxabcxx"));
+  EXPECT_FALSE(pf1.may_match("xxdefxx"));
+
+  // !(!abc | !def) is abc & def
+  auto e2 = negate(make<binary_op_type::OR>(negate(lit("abc")),
+                                            negate(lit("def"))));
+  prefilter pf2{*e2, lit_hint};
+  EXPECT_EQ(pf2.clauses().size(), 2u);
+  EXPECT_FALSE(pf2.may_match("abc"));
+  EXPECT_TRUE(pf2.may_match("abcdef"));
+
+  // an unconstrained alternative disables the filter
+  auto e3 = make<binary_op_type::OR>(
+      lit("abc"), std::make_unique<rule_expr>([] { return true; }, "any"));
+  prefilter pf3{*e3, lit_hint};
+  EXPECT_TRUE(pf3.empty());
+  EXPECT_TRUE(pf3.may_match(""));
+}
+
+TEST(prefilter_test, clauses_bounded) {
+  prefilter_options opts;
+  opts.max_clauses = 2;
+  opts.max_width = 2;
+
+  auto e = make<binary_op_type::AND>(
+      make<binary_op_type::AND>(lit("aa"), lit("bb")),
+      make<binary_op_type::OR>(
+          lit("cc"), make<binary_op_type::OR>(lit("dd"), lit("ee"))));
+  prefilter pf{*e, lit_hint, opts};
+  EXPECT_EQ(pf.clauses().size(), 2u);
+  EXPECT_TRUE(pf.may_match("aabb"));
+  EXPECT_FALSE(pf.may_match("aacc"));
+
+  auto incomplete = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  EXPECT_THROW((prefilter{*incomplete, lit_hint}), nexcept);
+}
+
+TEST(prefilter_test, sound_random) {
+  constexpr std::size_t leaves = 6;
+  std::mt19937 gen{11};
+  std::bernoulli_distribution coin{0.5};
+
+  for (unsigned seed = 0; seed < 100; ++seed) {
+    test::random_expr r{leaves, seed};
+    auto e = r.make(4);
+    prefilter pf{*e, [](const rule_expr &leaf) {
+                   return std::vector<std::string>{"<" + leaf.rule() + ">"};
+                 }};
+
+    for (int n = 0; n < 64; ++n) {
+      // a leaf may only hold if its literal is in the record
+      std::string record;
+      for (std::size_t i = 0; i < leaves; ++i) {
+        auto present = coin(gen);
+        if (present) {
+          record += "<r" + std::to_string(i) + ">";
+        }
+        r.values[i] = present && coin(gen);
+      }
+
+      if (e->interpret()) {
+        EXPECT_TRUE(pf.may_match(record)) << seed << " " << record;
+      }
+    }
+  }
+}
+
+TEST(prefilter_test, regex_literals) {
+  using lits = std::vector<std::string>;
+  EXPECT_EQ(regex_literals("CreateFile.*"), lits{"CreateFile"});
+  EXPECT_EQ(regex_literals("Create(File|Process)[AW]?"), lits{"Create"});
+  EXPECT_EQ(regex_literals("kernel32\\.dll"), lits{"kernel32.dll"});
+  EXPECT_EQ(regex_literals("ab?c"), (lits{"a", "c"}));
+  EXPECT_EQ(regex_literals("ab+c"), (lits{"ab", "c"}));
+  EXPECT_EQ(regex_literals("x{2,3}yz\\d+"), lits{"yz"});
+  EXPECT_EQ(regex_literals("[]a]bc"), lits{"bc"});
+  EXPECT_TRUE(regex_literals("abc|def").empty());
+  EXPECT_TRUE(regex_literals(".*").empty());
+
+  // operands of escapes are not literal text
+  EXPECT_EQ(regex_literals("ab\\x41BC"), (lits{"ab", "BC"}));
+  EXPECT_EQ(regex_literals("a\\u0042c"), (lits{"a", "c"}));
+  EXPECT_EQ(regex_literals("ab\\cJkl"), (lits{"ab", "kl"}));
+  EXPECT_EQ(regex_literals("ab\\0cd"), (lits{"ab", "cd"}));
+  EXPECT_EQ(regex_literals("(ab)x\\12y"), (lits{"x", "y"}));
+}
+
+TEST(prefilter_test, regex_escapes) {
+  // a record matching the regex of a leaf is never filtered out, \cJ
+  // being a line feed or a plain J depending on the regex implementation
+  const std::vector<std::pair<std::string, std::vector<std::string>>> cases{
+      {".*\\x41BC.*", {"xABCx"}},
+      {"a\\u0042c", {"aBc"}},
+      {"ab\\cJ", {"ab\n", "abJ"}},
+      {"ab\\0", {std::string{"ab\0", 3}}}};
+
+  for (const auto &[pattern, records] : cases) {
+    auto leaf = std::make_unique<rule_expr>([] { return true; }, pattern);
+    prefilter pf{*leaf, [](const rule_expr &e) {
+                   return regex_literals(e.rule());
+                 }};
+
+    std::size_t matched = 0;
+    for (const auto &record : records) {
+      if (std::regex_match(record, std::regex{pattern})) {
+        ++matched;
+        EXPECT_TRUE(pf.may_match(record)) << pattern;
+      }
+    }
+    EXPECT_GT(matched, 0u) << pattern;
+  }
+}
+
+//-------------------------------------
+// Entry point
+
+int prefilter_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "prefilter_test*";
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,151 @@
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/pushdown.h"
+
+#include "random_expr.h"
+
+using namespace n4;
+
+namespace {
+// records of leaf values, r0 is indexed exactly and r1 restricted to a
+// superset of its records
+class vector_source final : public record_source {
+public:
+  vector_source(test::random_expr &gen, std::size_t count, unsigned seed)
+      : m_gen{gen} {
+    std::mt19937 rnd{seed};
+    std::bernoulli_distribution coin{0.3};
+    for (std::size_t i = 0; i < count; ++i) {
+      std::vector<bool> rec(gen.values.size());
+      for (std::size_t l = 0; l < rec.size(); ++l) {
+        rec[l] = coin(rnd);
+      }
+      m_records.push_back(rec);
+      m_extra.push_back(coin(rnd));
+    }
+  }
+
+  std::size_t size() const override { return m_records.size(); }
+
+  pushed_leaf push(const rule_expr &leaf) override {
+    pushed_leaf p;
+    if (leaf.rule() == "r0") {
+      p.type = pushdown_type::EXACT;
+    } else if (leaf.rule() == "r1") {
+      p.type = pushdown_type::RESTRICT;
+    } else {
+      return p;
+    }
+
+    auto l = std::stoul(leaf.rule().substr(1));
+    for (std::size_t i = 0; i < m_records.size(); ++i) {
+      if (m_records[i][l] || (l == 1 && m_extra[i])) {
+        p.records.push_back(i);
+      }
+    }
+    return p;
+  }
+
+  void load(std::size_t record) override {
+    ++loads;
+    m_gen.values = m_records[record];
+    // an exactly pushed leaf must not be evaluated anymore
+    m_gen.values[0] = !m_gen.values[0];
+  }
+
+  // expected matches by plain evaluation
+  record_set expected(const expr &e) {
+    record_set out;
+    for (std::size_t i = 0; i < m_records.size(); ++i) {
+      m_gen.values = m_records[i];
+      if (e.interpret()) {
+        out.push_back(i);
+      }
+    }
+    return out;
+  }
+
+  std::size_t loads{0};
+
+private:
+  test::random_expr &m_gen;
+  std::vector<std::vector<bool>> m_records;
+  std::vector<bool> m_extra;
+};
+
+template <binary_op_type Op>
+std::unique_ptr<expr> make(std::unique_ptr<expr> op1,
+                           std::unique_ptr<expr> op2) {
+  auto e = std::make_unique<binary_gen_expr<Op>>();
+  e->set_left_op(std::move(op1));
+  e->set_right_op(std::move(op2));
+  return e;
+}
+} // namespace
+
+TEST(pushdown_test, filter_differential) {
+  for (unsigned seed = 0; seed < 100; ++seed) {
+    test::random_expr gen{4, seed};
+    auto e = gen.make(4);
+    vector_source src{gen, 200, seed};
+
+    auto expected = src.expected(*e);
+    auto res = pushdown_filter(*e, src);
+    EXPECT_EQ(res.matches, expected) << seed;
+    EXPECT_EQ(res.loaded, src.loads);
+    EXPECT_LE(res.pushed, 2u);
+  }
+}
+
+TEST(pushdown_test, filter_skips_records) {
+  test::random_expr gen{3, 0};
+  // r0 & (r1 | r2): only records of r0 are loaded
+  auto e = make<binary_op_type::AND>(
+      gen.leaf(0), make<binary_op_type::OR>(gen.leaf(1), gen.leaf(2)));
+  vector_source src{gen, 1000, 7};
+
+  auto expected = src.expected(*e);
+  auto res = pushdown_filter(*e, src);
+  EXPECT_EQ(res.matches, expected);
+  EXPECT_EQ(res.pushed, 2u);
+
+  EXPECT_LT(res.loaded, src.size() / 2);
+
+  // r0 alone is decided without loading anything
+  auto leaf = gen.leaf(0);
+  res = pushdown_filter(*leaf, src);
+  EXPECT_EQ(res.loaded, 0u);
+  EXPECT_EQ(res.matches, src.expected(*leaf));
+}
+
+TEST(pushdown_test, filter_bad_input) {
+  test::random_expr gen{2, 0};
+  vector_source src{gen, 10, 0};
+
+  auto incomplete = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  incomplete->set_left_op(gen.leaf(0));
+  EXPECT_THROW(pushdown_filter(*incomplete, src), nexcept);
+
+  struct bad_source final : public record_source {
+    std::size_t size() const override { return 4; }
+    pushed_leaf push(const rule_expr &) override {
+      return {pushdown_type::EXACT, {1, 4}};
+    }
+    void load(std::size_t) override {}
+  } bad;
+  EXPECT_THROW(pushdown_filter(*gen.leaf(0), bad), nexcept);
+}
+
+//-------------------------------------
+// Entry point
+
+int pushdown_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "pushdown_test*";
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "nforce/expr.h"
+
+namespace n4::test {
+///
+/// @brief Random expression trees over a shared leaf assignment
+///
+/// Leaf i reads values[i] and is named "ri" so that leaves drawn several
+/// times are the same leaf for expression analysis.
+///
+class random_expr {
+public:
+  random_expr(std::size_t leaves, unsigned seed)
+      : values(leaves, false), m_gen{seed} {}
+
+  std::unique_ptr<expr> make(std::size_t depth) {
+    std::uniform_int_distribution<int> kind{0, depth ? 5 : 0};
+    switch (kind(m_gen)) {
+    case 1:
+      return this->binary<binary_op_type::AND>(depth);
+    case 2:
+      return this->binary<binary_op_type::OR>(depth);
+    case 3: {
+      auto e = std::make_unique<unary_not_expr>();
+      e->set_op(this->make(depth - 1));
+      return e;
+    }
+    case 4:
+      return this->nary<binary_op_type::AND>(depth);
+    case 5:
+      return this->nary<binary_op_type::OR>(depth);
+    default:
+      return this->leaf();
+    }
+  }
+
+  std::unique_ptr<expr> leaf() {
+    std::uniform_int_distribution<std::size_t> pick{0, values.size() - 1};
+    return this->leaf(pick(m_gen));
+  }
+
+  std::unique_ptr<expr> leaf(std::size_t i) {
+    return std::make_unique<rule_expr>([this, i] { return values[i]; },
+                                       "r" + std::to_string(i));
+  }
+
+  // set leaf values from the bits of an assignment index
+  void assign(std::size_t index) {
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      values[i] = (index >> i) & 1u;
+    }
+  }
+
+  std::vector<bool> values;
+
+private:
+  template <binary_op_type Op> std::unique_ptr<expr> binary(std::size_t depth) {
+    auto e = std::make_unique<binary_gen_expr<Op>>();
+    e->set_left_op(this->make(depth - 1));
+    e->set_right_op(this->make(depth - 1));
+    return e;
+  }
+
+  template <binary_op_type Op> std::unique_ptr<expr> nary(std::size_t depth) {
+    auto e = std::make_unique<nary_gen_expr<Op>>();
+    std::uniform_int_distribution<std::size_t> size{1, 4};
+    for (auto n = size(m_gen); n > 0; --n) {
+      e->add_op(this->make(depth - 1));
+    }
+    return e;
+  }
+
+  std::mt19937 m_gen;
+};
+} // namespace n4::test
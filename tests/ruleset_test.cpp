@@ -0,0 +1,234 @@
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/ruleset.h"
+
+using namespace n4;
+
+namespace {
+struct ruleset_test : public ::testing::Test {
+  std::vector<parser::rule_handler> handlers() {
+    return {std::make_pair(
+        [this](const std::string &str) {
+          ++checks;
+          return str.rfind("tag=", 0) == 0;
+        },
+        [](const std::string &str) { return str == "tag=on"; })};
+  }
+
+  std::atomic<int> checks{0};
+};
+} // namespace
+
+TEST_F(ruleset_test, reload_incremental) {
+  ruleset rs{this->handlers()};
+  ruleset::reader rd{rs};
+
+  EXPECT_EQ(rs.reload({{"r1", "'tag=on'|'tag=no'"},
+                       {"r2", "'tag=off'&'tag=on'"},
+                       {"r3", "'tag=on'"}}),
+            3u);
+  const expr *e1 = nullptr;
+  const expr *e2 = nullptr;
+  {
+    auto v = rd.read();
+    ASSERT_EQ(v->size(), 3u);
+    ASSERT_TRUE(v->find("r1"));
+    EXPECT_TRUE(v->find("r1")->expression->interpret());
+    EXPECT_FALSE(v->find("r2")->expression->interpret());
+    EXPECT_EQ(v->find("r4"), nullptr);
+    e1 = v->find("r1")->expression.get();
+    e2 = v->find("r2")->expression.get();
+  }
+  auto checked = checks.load();
+
+  // r2 rebuilt from known leaves, r3 removed, r1 kept as is
+  EXPECT_EQ(rs.reload({{"r1", "'tag=on'|'tag=no'"},
+                       {"r2", "'tag=on'&'tag=on'"}}),
+            1u);
+  EXPECT_EQ(checks.load(), checked);
+  {
+    auto v = rd.read();
+    EXPECT_EQ(v->size(), 2u);
+    EXPECT_EQ(v->find("r1")->expression.get(), e1);
+    EXPECT_NE(v->find("r2")->expression.get(), e2);
+    EXPECT_TRUE(v->find("r2")->expression->interpret());
+    EXPECT_EQ(v->find("r3"), nullptr);
+  }
+
+  // no change, no new version
+  auto id = rd.read()->id();
+  EXPECT_EQ(rs.update({{"r1", std::string{"'tag=on'|'tag=no'"}}}), 0u);
+  EXPECT_EQ(rd.read()->id(), id);
+
+  EXPECT_EQ(rs.update({{"r1", std::nullopt}, {"r5", std::string{"'tag=x'"}}}),
+            1u);
+  EXPECT_EQ(checks.load(), checked + 1);
+  EXPECT_EQ(rd.read()->size(), 2u);
+  EXPECT_EQ(rs.reclaim(), 0u);
+}
+
+TEST_F(ruleset_test, reload_failure) {
+  ruleset rs{this->handlers()};
+  ruleset::reader rd{rs};
+  rs.reload({{"r1", "'tag=on'"}});
+  auto id = rd.read()->id();
+
+  EXPECT_THROW(rs.reload({{"r1", "'tag=on'"}, {"r2", "'name=on'"}}), nexcept);
+  EXPECT_EQ(rd.read()->id(), id);
+  EXPECT_EQ(rd.read()->size(), 1u);
+}
+
+TEST_F(ruleset_test, reclaim_pinned) {
+  ruleset rs{this->handlers()};
+  ruleset::reader rd{rs};
+  rs.reload({{"r1", "'tag=on'"}});
+
+  {
+    auto v = rd.read();
+    rs.reload({{"r1", "'tag=off'"}});
+    rs.reload({{"r1", "'tag=no'"}});
+    // pinned version still alive and unchanged
+    EXPECT_TRUE(v->find("r1")->expression->interpret());
+    EXPECT_EQ(rs.reclaim(), 2u);
+  }
+  EXPECT_EQ(rs.reclaim(), 0u);
+  EXPECT_FALSE(rd.read()->find("r1")->expression->interpret());
+}
+
+TEST_F(ruleset_test, reload_concurrent) {
+  ruleset rs{this->handlers()};
+  rs.reload({{"r1", "'tag=on'"}, {"r2", "'tag=on'"}});
+
+  std::atomic<bool> done{false};
+  std::atomic<std::size_t> errors{0};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 3; ++i) {
+    readers.emplace_back([&] {
+      ruleset::reader rd{rs};
+      while (!done.load()) {
+        auto v = rd.read();
+        // both rules always share the same text within a version
+        const auto *r1 = v->find("r1");
+        const auto *r2 = v->find("r2");
+        if (!r1 || !r2 || r1->expression->interpret() !=
+                              r2->expression->interpret()) {
+          ++errors;
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < 200; ++i) {
+    auto text = (i % 2) ? "'tag=on'" : "'tag=off'";
+    rs.reload({{"r1", text}, {"r2", text}});
+  }
+  done = true;
+  for (auto &t : readers) {
+    t.join();
+  }
+
+  EXPECT_EQ(errors.load(), 0u);
+  EXPECT_EQ(rs.reclaim(), 0u);
+}
+
+TEST_F(ruleset_test, reload_lazy) {
+  std::atomic<int> compiles{0};
+  parser::compiler_cb compiler = [&](const std::string &str) {
+    ++compiles;
+    return rule_expr::interpretor{[on = (str == "tag=on")] { return on; }};
+  };
+
+  parser_options opts;
+  opts.lazy = true;
+  ruleset rs{std::vector<parser::rule_handler>{
+                 {[](const std::string &str) {
+                    return str.rfind("tag=", 0) == 0;
+                  },
+                  compiler}},
+             opts};
+  ruleset::reader rd{rs};
+
+  rs.reload({{"r1", "'tag=on'"}, {"r2", "'tag=off'"}});
+  EXPECT_EQ(compiles.load(), 0);
+
+  // only evaluated rules are compiled
+  auto v = rd.read();
+  EXPECT_TRUE(v->find("r1")->expression->interpret());
+  EXPECT_TRUE(v->find("r1")->expression->interpret());
+  EXPECT_EQ(compiles.load(), 1);
+}
+
+TEST_F(ruleset_test, reload_leaf_cache) {
+  std::unordered_map<std::string, int> compiles;
+  parser::compiler_cb compiler = [&](const std::string &str) {
+    ++compiles[str];
+    return rule_expr::interpretor{[on = (str == "tag=on")] { return on; }};
+  };
+
+  ruleset rs{std::vector<parser::rule_handler>{
+      {[](const std::string &str) { return str.rfind("tag=", 0) == 0; },
+       compiler}}};
+  ruleset::reader rd{rs};
+
+  rs.reload({{"r1", "'tag=on'|'tag=a'"}, {"r2", "'tag=b'"}});
+  EXPECT_EQ(rs.cached_leaves(), 3u);
+
+  // unchanged leaves of a changed rule are not compiled again
+  rs.reload({{"r1", "'tag=on'|'tag=c'"}, {"r2", "'tag=b'&'tag=a'"}});
+  EXPECT_TRUE(rd.read()->find("r1")->expression->interpret());
+  EXPECT_EQ(compiles["tag=on"], 1);
+  EXPECT_EQ(compiles["tag=a"], 1);
+  EXPECT_EQ(compiles["tag=b"], 1);
+  EXPECT_EQ(compiles["tag=c"], 1);
+
+  // leaves of freed versions leave the cache, once no reader holds them
+  {
+    auto v = rd.read();
+    rs.reload({{"r1", "'tag=on'"}});
+    EXPECT_EQ(rs.cached_leaves(), 4u);
+  }
+  EXPECT_EQ(rs.reclaim(), 0u);
+  EXPECT_EQ(rs.cached_leaves(), 1u);
+
+  rs.reload({});
+  EXPECT_EQ(rs.cached_leaves(), 0u);
+}
+
+TEST_F(ruleset_test, reload_concurrent_update) {
+  ruleset rs{this->handlers()};
+  ruleset::reader rd{rs};
+
+  // a reload replaces all rules whatever the updates it races with
+  std::atomic<bool> done{false};
+  std::thread updater{[&] {
+    for (int i = 0; !done; ++i) {
+      rs.update({{"u" + std::to_string(i % 8), std::string{"'tag=on'"}}});
+    }
+  }};
+
+  for (int i = 0; i < 200; ++i) {
+    rs.reload({{"r1", "'tag=on'"}});
+    auto v = rd.read();
+    EXPECT_TRUE(v->find("r1"));
+  }
+  done = true;
+  updater.join();
+
+  rs.reload({{"r1", "'tag=on'"}});
+  EXPECT_EQ(rd.read()->size(), 1u);
+}
+
+//-------------------------------------
+// Entry point
+
+int ruleset_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "ruleset_test*";
+
+  return RUN_ALL_TESTS();
+}
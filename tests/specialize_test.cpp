@@ -0,0 +1,135 @@
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/leaves.h"
+#include "nforce/specialize.h"
+#include "random_expr.h"
+
+using namespace n4;
+
+namespace {
+template <binary_op_type Op>
+std::unique_ptr<expr> make(std::unique_ptr<expr> op1,
+                           std::unique_ptr<expr> op2) {
+  auto e = std::make_unique<binary_gen_expr<Op>>();
+  e->set_left_op(std::move(op1));
+  e->set_right_op(std::move(op2));
+  return e;
+}
+} // namespace
+
+TEST(specialize_test, fold_known) {
+  test::random_expr r{3, 0};
+  // (r0 & r1) | !r2
+  auto not2 = std::make_unique<unary_not_expr>();
+  not2->set_op(r.leaf(2));
+  auto e = make<binary_op_type::OR>(
+      make<binary_op_type::AND>(r.leaf(0), r.leaf(1)), std::move(not2));
+
+  // r0 false: !r2 remains
+  auto res1 = specialize(*e, {{"r0", false}});
+  leaf_set l1{*res1};
+  ASSERT_EQ(l1.size(), 1u);
+  EXPECT_EQ(l1[0].rule(), "r2");
+  r.values = {true, true, false};
+  EXPECT_TRUE(res1->interpret());
+  r.values = {true, true, true};
+  EXPECT_FALSE(res1->interpret());
+
+  // r2 false: decided whatever r0 and r1
+  auto res2 = specialize(*e, {{"r2", false}});
+  leaf_set l2{*res2};
+  EXPECT_EQ(l2.size(), 1u);
+  EXPECT_TRUE(l2[0].rule().empty());
+  r.values = {false, false, true};
+  EXPECT_TRUE(res2->interpret());
+
+  // nothing known: same leaves
+  auto res3 = specialize(*e, std::unordered_map<std::string, bool>{});
+  EXPECT_EQ(leaf_set{*res3}.size(), 3u);
+
+  auto incomplete = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  EXPECT_THROW(specialize(*incomplete, {{"r0", true}}), nexcept);
+}
+
+TEST(specialize_test, fold_exhaustive) {
+  constexpr std::size_t leaves = 4;
+  for (unsigned seed = 0; seed < 50; ++seed) {
+    test::random_expr r{leaves, seed};
+    auto e = r.make(4);
+
+    // every subset of known leaves with every value of the known leaves
+    for (std::size_t mask = 0; mask < (1u << leaves); ++mask) {
+      for (std::size_t known = 0; known < (1u << leaves); ++known) {
+        if (known & ~mask) {
+          continue;
+        }
+
+        auto res = specialize(*e, [&](const rule_expr &leaf) {
+          auto i = std::stoul(leaf.rule().substr(1));
+          return (mask >> i) & 1u ? std::optional<bool>{(known >> i) & 1u}
+                                  : std::nullopt;
+        });
+
+        leaf_set residual_leaves{*res};
+        for (std::size_t i = 0; i < residual_leaves.size(); ++i) {
+          const auto &rule = residual_leaves[i].rule();
+          if (!rule.empty()) {
+            EXPECT_FALSE((mask >> std::stoul(rule.substr(1))) & 1u);
+          }
+        }
+
+        for (std::size_t a = 0; a < (1u << leaves); ++a) {
+          if ((a & mask) != known) {
+            continue;
+          }
+          r.assign(a);
+          EXPECT_EQ(res->interpret(), e->interpret())
+              << seed << " " << mask << " " << a;
+        }
+      }
+    }
+  }
+}
+
+TEST(specialize_test, specializer_cache) {
+  test::random_expr r{2, 0};
+  auto e = make<binary_op_type::AND>(r.leaf(0), r.leaf(1));
+
+  specializer<int> s{*e, 2};
+  std::size_t calls = 0;
+  auto oracle = [&](bool v0) {
+    return [&calls, v0](const rule_expr &leaf) -> std::optional<bool> {
+      ++calls;
+      return leaf.rule() == "r0" ? std::optional<bool>{v0} : std::nullopt;
+    };
+  };
+
+  auto res1 = s.get(1, oracle(true));
+  // r1 is not looked at once r0 decides the AND
+  auto res2 = s.get(2, oracle(false));
+  EXPECT_EQ(calls, 3u);
+  EXPECT_EQ(s.get(1, oracle(true)), res1);
+  EXPECT_EQ(calls, 3u);
+  EXPECT_EQ(s.size(), 2u);
+
+  r.values = {false, true};
+  EXPECT_TRUE(res1->interpret());
+  EXPECT_FALSE(res2->interpret());
+
+  // full cache is cleared, residuals stay valid
+  s.get(3, oracle(true));
+  EXPECT_EQ(s.size(), 1u);
+  EXPECT_TRUE(res1->interpret());
+}
+
+//-------------------------------------
+// Entry point
+
+int specialize_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "specialize_test*";
+
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,150 @@
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/speculative.h"
+
+#include "random_expr.h"
+
+using namespace n4;
+using namespace std::chrono_literals;
+
+namespace {
+template <binary_op_type Op>
+std::unique_ptr<expr> make(std::unique_ptr<expr> op1,
+                           std::unique_ptr<expr> op2) {
+  auto e = std::make_unique<binary_gen_expr<Op>>();
+  e->set_left_op(std::move(op1));
+  e->set_right_op(std::move(op2));
+  return e;
+}
+
+// leaf answering after a delay, stopping early when cancelled
+std::unique_ptr<expr> slow(const std::string &rule, bool value,
+                           std::chrono::milliseconds delay,
+                           std::atomic<int> *cancelled = nullptr) {
+  return std::make_unique<rule_expr>(
+      [=] {
+        auto end = std::chrono::steady_clock::now() + delay;
+        while (std::chrono::steady_clock::now() < end) {
+          if (cancellation_requested()) {
+            if (cancelled) {
+              ++*cancelled;
+            }
+            return !value;
+          }
+          std::this_thread::sleep_for(1ms);
+        }
+        return value;
+      },
+      rule);
+}
+
+bool always(const rule_expr &) { return true; }
+} // namespace
+
+TEST(speculative_test, interpret_differential) {
+  executor pool{2};
+  for (unsigned seed = 0; seed < 100; ++seed) {
+    test::random_expr gen{5, seed};
+    // same seed, same tree to compare with
+    test::random_expr ref_gen{5, seed};
+    auto ref = ref_gen.make(4);
+    speculative_expr spec{gen.make(4), pool, always};
+
+    for (std::size_t a = 0; a < 32; ++a) {
+      gen.assign(a);
+      ref_gen.assign(a);
+      EXPECT_EQ(spec.interpret(), ref->interpret()) << seed << " " << a;
+    }
+  }
+}
+
+TEST(speculative_test, interpret_first_decides) {
+  executor pool{2};
+  std::atomic<int> cancelled{0};
+
+  // sequential evaluation would wait for the slow operand first
+  speculative_expr spec{
+      make<binary_op_type::AND>(slow("slow", true, 2000ms, &cancelled),
+                                slow("fast", false, 10ms)),
+      pool, always};
+  EXPECT_EQ(spec.parallel_nodes(), 1u);
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(spec.interpret());
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 1000ms);
+  EXPECT_EQ(cancelled.load(), 1);
+  EXPECT_FALSE(cancellation_requested());
+}
+
+TEST(speculative_test, interpret_cheap_sequential) {
+  executor pool{2};
+  test::random_expr gen{2, 0};
+
+  // a single expensive operand keeps the node sequential
+  speculative_expr spec{make<binary_op_type::OR>(gen.leaf(0), gen.leaf(1)),
+                        pool,
+                        [](const rule_expr &r) { return r.rule() == "r0"; }};
+  EXPECT_EQ(spec.parallel_nodes(), 0u);
+
+  gen.values = {false, true};
+  EXPECT_TRUE(spec.interpret());
+}
+
+TEST(speculative_test, interpret_saturated) {
+  executor pool{1};
+  std::promise<void> release;
+  auto blocked = release.get_future().share();
+  std::promise<void> started;
+  pool.submit([&, blocked](std::size_t) {
+    started.set_value();
+    blocked.wait();
+  });
+  started.get_future().wait();
+
+  // the only worker is busy, evaluation stays on the calling thread
+  speculative_expr spec{make<binary_op_type::OR>(slow("a", false, 1ms),
+                                                 slow("b", true, 1ms)),
+                        pool, always};
+  EXPECT_TRUE(spec.interpret());
+  release.set_value();
+}
+
+TEST(speculative_test, interpret_exception) {
+  executor pool{2};
+  auto failing = [] {
+    return std::make_unique<rule_expr>(
+        []() -> bool { throw std::runtime_error{"leaf failure"}; }, "ko");
+  };
+
+  // another operand decides, the failure is ignored
+  speculative_expr decided{
+      make<binary_op_type::OR>(failing(), slow("ok", true, 20ms)), pool,
+      always};
+  EXPECT_TRUE(decided.interpret());
+
+  speculative_expr undecided{
+      make<binary_op_type::OR>(failing(), slow("ok", false, 20ms)), pool,
+      always};
+  EXPECT_THROW(undecided.interpret(), std::runtime_error);
+
+  auto incomplete = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  EXPECT_THROW((speculative_expr{std::move(incomplete), pool, always}),
+               nexcept);
+}
+
+//-------------------------------------
+// Entry point
+
+int speculative_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "speculative_test*";
+
+  return RUN_ALL_TESTS();
+}
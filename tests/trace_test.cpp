@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "nforce/expr.h"
+#include "nforce/lexer.h"
+#include "nforce/parser.h"
+#include "nforce/trace.h"
+
+using namespace n4;
+
+namespace {
+struct trace_test : public ::testing::Test {
+  trace_test() { drain_traces(); }
+  ~trace_test() { enable_tracing(false); }
+
+  std::unique_ptr<expr> build(const std::string &filter) {
+    auto prefix = [](const std::string &p) {
+      return [p](const std::string &str) { return str.rfind(p, 0) == 0; };
+    };
+    auto never = [](const std::string &) { return false; };
+    auto always = [](const std::string &) { return true; };
+
+    lexer lex{filter};
+    parser p{lex, std::vector<parser::rule_handler>{{prefix("a="), never},
+                                                    {prefix("b="), always}}};
+    return p.build();
+  }
+
+  static std::size_t count(const std::vector<trace_event> &events,
+                           trace_phase phase) {
+    return static_cast<std::size_t>(
+        std::count_if(std::cbegin(events), std::cend(events),
+                      [phase](const auto &e) { return e.phase == phase; }));
+  }
+};
+} // namespace
+
+TEST_F(trace_test, chrome_export) {
+  std::vector<trace_event> events(2);
+  events[0].phase = trace_phase::MATCH;
+  events[0].expr_id = 7;
+  events[0].handler = 2;
+  events[0].thread = 3;
+  events[0].begin = 1000;
+  events[0].end = 3500;
+  events[1].phase = trace_phase::INTERPRET;
+
+  std::ostringstream os;
+  write_chrome_trace(os, events);
+  auto json = os.str();
+
+  EXPECT_EQ(json.find("{\"traceEvents\":["), 0u);
+  EXPECT_NE(json.find("\"name\":\"match\""), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+  EXPECT_NE(json.find("\"tid\":3"), std::string::npos);
+  EXPECT_NE(json.find("\"ts\":1.000"), std::string::npos);
+  EXPECT_NE(json.find("\"dur\":2.500"), std::string::npos);
+  EXPECT_NE(json.find("\"args\":{\"expr\":7,\"handler\":2}"),
+            std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"interpret\""), std::string::npos);
+  EXPECT_NE(json.find("\"args\":{\"expr\":0}"), std::string::npos);
+}
+
+TEST_F(trace_test, record_disabled) {
+  enable_tracing(false);
+  auto e = this->build("'a=x' | 'b=y'");
+  e->interpret();
+  EXPECT_TRUE(drain_traces().empty());
+
+  if (!tracing_available()) {
+    // compiled out, nothing is ever recorded
+    enable_tracing(true);
+    EXPECT_FALSE(tracing_enabled());
+    this->build("'a=x'")->interpret();
+    EXPECT_TRUE(drain_traces().empty());
+  }
+}
+
+TEST_F(trace_test, record_phases) {
+  if (!tracing_available()) {
+    return;
+  }
+
+  enable_tracing(true);
+  auto e = this->build("'a=x' | 'b=y'");
+  EXPECT_TRUE(e->interpret());
+  enable_tracing(false);
+
+  auto events = drain_traces();
+  EXPECT_EQ(this->count(events, trace_phase::BUILD), 1u);
+  EXPECT_EQ(this->count(events, trace_phase::MATCH), 2u);
+  EXPECT_EQ(this->count(events, trace_phase::INTERPRET), 2u);
+  // two rules, one operator and the end
+  EXPECT_EQ(this->count(events, trace_phase::LEX), 4u);
+
+  auto build = std::find_if(
+      std::cbegin(events), std::cend(events),
+      [](const auto &ev) { return ev.phase == trace_phase::BUILD; });
+  ASSERT_NE(build, std::cend(events));
+  EXPECT_NE(build->expr_id, 0u);
+
+  std::vector<std::uint32_t> handlers;
+  for (const auto &ev : events) {
+    // every span is tagged with the built expression
+    EXPECT_EQ(ev.expr_id, build->expr_id);
+    EXPECT_LE(ev.begin, ev.end);
+    if (ev.phase == trace_phase::LEX || ev.phase == trace_phase::MATCH) {
+      EXPECT_GE(ev.begin, build->begin);
+      EXPECT_LE(ev.end, build->end);
+    }
+    if (ev.phase == trace_phase::INTERPRET) {
+      handlers.push_back(ev.handler);
+    }
+  }
+  EXPECT_EQ(handlers, (std::vector<std::uint32_t>{0, 1}));
+
+  // nothing left once drained
+  EXPECT_TRUE(drain_traces().empty());
+}
+
+TEST_F(trace_test, record_threads) {
+  if (!tracing_available()) {
+    return;
+  }
+
+  auto e = this->build("'b=y'");
+  enable_tracing(true);
+  e->interpret();
+  std::thread t{[&] { e->interpret(); }};
+  t.join();
+  enable_tracing(false);
+
+  // spans of finished threads are kept until drained
+  auto events = drain_traces();
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_NE(events[0].thread, events[1].thread);
+  EXPECT_EQ(events[0].expr_id, events[1].expr_id);
+}
+
+//-------------------------------------
+// Entry point
+
+int trace_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "trace_test*";
+
+  return RUN_ALL_TESTS();
+}
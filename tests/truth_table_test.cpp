@@ -0,0 +1,116 @@
+#include "gtest/gtest.h"
+
+#include "nforce/core/except.h"
+#include "nforce/expr.h"
+#include "nforce/truth_table.h"
+
+#include "random_expr.h"
+
+using namespace n4;
+
+TEST(truth_table_test, interpret_exhaustive) {
+  for (unsigned seed = 0; seed < 50; ++seed) {
+    test::random_expr gen{10, seed};
+    auto ref = gen.make(6);
+
+    // same seed, same tree
+    test::random_expr gen2{10, seed};
+    truth_table_expr table{gen2.make(6)};
+    ASSERT_LE(table.leaves().size(), 10u);
+
+    for (std::size_t i = 0; i < (1u << 10); ++i) {
+      gen.assign(i);
+      gen2.assign(i);
+      ASSERT_EQ(table.interpret(), ref->interpret()) << seed << " " << i;
+    }
+  }
+}
+
+TEST(truth_table_test, interpret_max_leaves) {
+  test::random_expr gen{truth_table_expr::max_leaves, 7};
+
+  // left deep chain alternating operators, leaf i is table bit i
+  std::unique_ptr<expr> ref = gen.leaf(0);
+  for (std::size_t i = 1; i < truth_table_expr::max_leaves; ++i) {
+    std::unique_ptr<binary_expr> e;
+    if (i % 2) {
+      e = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+    } else {
+      e = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+    }
+    e->set_left_op(std::move(ref));
+    e->set_right_op(gen.leaf(i));
+    ref = std::move(e);
+  }
+
+  // truth table shares the leaves of its source tree
+  const auto *src = ref.get();
+  truth_table_expr table{std::move(ref)};
+  EXPECT_EQ(table.leaves().size(), truth_table_expr::max_leaves);
+
+  for (std::size_t i = 0; i < (1u << truth_table_expr::max_leaves); ++i) {
+    gen.assign(i);
+    ASSERT_EQ(table.interpret(), src->interpret()) << i;
+    ASSERT_EQ(table.lookup(static_cast<std::uint32_t>(i)), src->interpret());
+  }
+}
+
+TEST(truth_table_test, interpret_shared_leaves) {
+  test::random_expr gen{2, 0};
+
+  // r0 & !r0 | r1 has two distinct leaves
+  auto e = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+  auto a = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  auto n = std::make_unique<unary_not_expr>();
+  n->set_op(gen.leaf(0));
+  a->set_left_op(gen.leaf(0));
+  a->set_right_op(std::move(n));
+  e->set_left_op(std::move(a));
+  e->set_right_op(gen.leaf(1));
+
+  truth_table_expr table{std::move(e)};
+  EXPECT_EQ(table.leaves().size(), 2u);
+  EXPECT_FALSE(table.lookup(0b01));
+  EXPECT_TRUE(table.lookup(0b10));
+  EXPECT_TRUE(table.lookup(0b11));
+}
+
+TEST(truth_table_test, compile_fallback) {
+  test::random_expr gen{truth_table_expr::max_leaves + 1, 0};
+
+  std::unique_ptr<expr> root = gen.leaf(0);
+  for (std::size_t i = 1; i < gen.values.size(); ++i) {
+    auto e = std::make_unique<binary_gen_expr<binary_op_type::OR>>();
+    e->set_left_op(std::move(root));
+    e->set_right_op(gen.leaf(i));
+    root = std::move(e);
+  }
+
+  const auto *src = root.get();
+  auto compiled = compile_truth_table(std::move(root));
+  EXPECT_EQ(compiled.get(), src);
+
+  compiled = compile_truth_table(gen.leaf(0));
+  EXPECT_NE(dynamic_cast<truth_table_expr *>(compiled.get()), nullptr);
+
+  compiled = compile_truth_table(gen.leaf(0), 0);
+  EXPECT_EQ(dynamic_cast<truth_table_expr *>(compiled.get()), nullptr);
+}
+
+TEST(truth_table_test, build_bad_ast) {
+  auto e = std::make_unique<binary_gen_expr<binary_op_type::AND>>();
+  e->set_left_op(std::make_unique<rule_expr>([] { return true; }));
+
+  EXPECT_THROW(truth_table_expr{std::move(e)}, nexcept);
+  EXPECT_THROW(truth_table_expr{nullptr}, nexcept);
+}
+
+//-------------------------------------
+// Entry point
+
+int truth_table_test(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  ::testing::FLAGS_gtest_filter = "truth_table_test*";
+
+  return RUN_ALL_TESTS();
+}